@@ -2,37 +2,42 @@
 
 #include "graph.h"
 #include "timestamp_vector.h"
-#include "base/id_queue.h"
-#include "base/constants.h"
+#include "id_queue.h"
+#include "constants.h"
 #include "contraction.h"
 #include "performance_logger.h"
-#include "boolset.h"
+#include "atomic_bitset.h"
+#include "atomic_timestamp_vector.h"
 #include "potentials.h"
+#include "search_stats.h"
 #include <unordered_set>
 #include <ctype.h>
 #include <thread>
-#include <mutex>
+#include <atomic>
 
+template <class GraphT>
 class AStarService {
 
 	private:
-		const Graph& g;
+		const GraphT& g;
 		HeuristicProvider& heur;
 		std::unordered_set<node_t> closed_list;
 		TimestampVector<uint32_t> dist_vec;
 		TimestampVector<uint32_t> prev_vec;
+		TimestampVector<uint32_t> prev_arc_vec; // Only filled if GraphT has arc ids
 		MinIDQueue queue;
 		uint32_t max_dist = inf_weight;
 
 
 	public:
-		AStarService(const Graph& _g, HeuristicProvider& heur) : g(_g), heur(heur), dist_vec(_g.size(), inf_weight), prev_vec(_g.size(), invalid_id), queue(g.size()) {
+		AStarService(const GraphT& _g, HeuristicProvider& heur) : g(_g), heur(heur), dist_vec(_g.size(), inf_weight), prev_vec(_g.size(), invalid_id), prev_arc_vec(_g.size(), invalid_id), queue(g.size()) {
 			dist_vec.step_time();
 			prev_vec.step_time();
 		}
 
 		void add_source(node_t n) {
 			queue.push({ n, heur(n) });
+			count_push(StatsScope::ASTAR);
 			dist_vec.set(n, 0);
 			prev_vec.set(n, invalid_id);
 		}
@@ -47,7 +52,9 @@ class AStarService {
 
 		node_t step() {
 			IDKeyPair best = queue.pop();
-			const std::vector<Edge>& arcs = g.get_out_arcs(best.id);
+			const auto& arcs = g.get_out_arcs(best.id);
+			count_settled(StatsScope::ASTAR);
+			count_relaxed(StatsScope::ASTAR, arcs.size());
 			for (int i = 0; i < arcs.size(); i++) {
 				if (closed_list.count(arcs[i].target) > 0) {
 					continue;
@@ -57,6 +64,9 @@ class AStarService {
 					continue;
 				}
 				prev_vec.set(arcs[i].target, best.id);
+				if constexpr (has_arc_ids<GraphT>) {
+					prev_arc_vec.set(arcs[i].target, g.get_out_arc_id(best.id, i));
+				}
 				dist_vec.set(arcs[i].target, tentative_g);
 				uint32_t h = heur(arcs[i].target);
 				uint32_t f = tentative_g + h;
@@ -66,26 +76,34 @@ class AStarService {
 				if (queue.contains_id(arcs[i].target)) {
 					if (f < queue.get_key(arcs[i].target)) {
 						queue.decrease_key({ arcs[i].target, f });
+						count_decrease_key(StatsScope::ASTAR);
 					}
 				} else {
 					queue.push({ arcs[i].target, f });
+					count_push(StatsScope::ASTAR);
 				}
 			}
 			return best.id;
 		}
 
+		// Path::edges is only filled if GraphT has arc ids.
 		Path get_path(node_t target) {
-			std::vector<node_t> path;
-			uint32_t dist = get_dist(target);
-			if (dist == inf_weight) {
-				return { std::vector<node_t>(), dist };
+			Path ret = { std::vector<node_t>(), get_dist(target), std::vector<uint32_t>() };
+			if (ret.length == inf_weight) {
+				return ret;
 			}
 			while (target != invalid_id) {
-				path.push_back(target);
+				ret.nodes.push_back(target);
+				if constexpr (has_arc_ids<GraphT>) {
+					if (prev_vec.get(target) != invalid_id) {
+						ret.edges.push_back(prev_arc_vec.get(target));
+					}
+				}
 				target = prev_vec.get(target);
 			}
-			std::reverse(path.begin(), path.end());
-			return { path, dist };
+			std::reverse(ret.nodes.begin(), ret.nodes.end());
+			std::reverse(ret.edges.begin(), ret.edges.end());
+			return ret;
 		}
 
 		void run_until_target_found(node_t target) {
@@ -104,71 +122,98 @@ class AStarService {
 			closed_list.clear();
 			dist_vec.step_time();
 			prev_vec.step_time();
+			prev_arc_vec.step_time();
 			queue.clear();
 		}
 };
 
+// PARALLEL runs forward and backward search in two threads that are started for every query.
+// INTERLEAVED alternates both searches on the calling thread, always advancing the side with the
+// smaller top key. It avoids the thread start per query, which dominates on short routes.
+enum class BidirectionalMode { PARALLEL, INTERLEAVED };
+
+// Bidirectional A* with average potentials. In PARALLEL mode, each thread only writes its own
+// labels, the other thread reads them through atomics. The best meeting point found so far is a
+// packed (length, node) word that is only ever decreased.
+// GraphT needs forward and reverse arcs, e.g. StaticGraph or PenalizedGraph.
+template <class GraphT>
 class BidirectionalAStarService {
 
 private:
-	const Graph& g;
-	// To prevent synchronization from slowing down the search too much,
-	// both threads get their own heuristic vector.
-	CHPotentialService pot_f1;
-	CHPotentialService pot_f2;
-	ReverseCHPotentialService pot_r1;
-	ReverseCHPotentialService pot_r2;
-	BoolSet closed_f, closed_r;
+	const GraphT& g;
+	BidirectionalMode mode;
+	// Shared by both threads
+	SharedCHPotentialService pot_f;
+	SharedReverseCHPotentialService pot_r;
+	AtomicBitSet closed_f, closed_r;
 	MinIDQueue q_f, q_r;
-	TimestampVector<uint32_t> dist_f, dist_r;
+	AtomicTimestampVector dist_f, dist_r;
 	TimestampVector<node_t> par_f, par_r;
-	uint32_t tentative_dist = inf_weight;
-	node_t best_node = invalid_id;
+	TimestampVector<uint32_t> par_arc_f, par_arc_r; // Forward arc id of the arc to the parent
+	std::atomic<uint64_t> meeting; // tentative_dist << 32 | best_node
 	node_t source = invalid_id;
 	node_t target = invalid_id;
-	std::vector<std::mutex> locks;
-	uint32_t min_key_f = inf_weight;
-	uint32_t k_f = 0; // Top key of forward queue
-	uint32_t k_r = 0;
+	uint32_t stop_offset = 0; // heur_f(n) + heur_r(n), the same for all nodes
+	std::atomic<uint32_t> k_f; // Top key of forward queue
+	std::atomic<uint32_t> k_r;
+	SearchStatsTable stats_f, stats_r; // Counts of the search threads in PARALLEL mode
 
-	uint32_t heur_f1(node_t n) {
-		return (pot_f1(n) + pot_r1(target) - pot_r1(n)) / 2;
+	static uint64_t pack_meeting(uint32_t dist, node_t node) {
+		return ((uint64_t)dist << 32) | node;
 	}
 
-	uint32_t heur_r1(node_t n) {
-		return (pot_r1(n) + pot_f1(source) - pot_f1(n)) / 2;
+	uint32_t get_tentative_dist() const {
+		return meeting.load() >> 32;
 	}
 
-	uint32_t heur_f2(node_t n) {
-		return (pot_f2(n) + pot_r2(target) - pot_r2(n)) / 2;
+	node_t get_best_node() const {
+		return (node_t)meeting.load();
 	}
 
-	uint32_t heur_r2(node_t n) {
-		return (pot_r2(n) + pot_f2(source) - pot_f2(n)) / 2;
+	void update_meeting(uint32_t dist, node_t node) {
+		uint64_t current = meeting.load();
+		uint64_t desired = pack_meeting(dist, node);
+		while ((current >> 32) > dist && !meeting.compare_exchange_weak(current, desired)) {}
 	}
 
+	uint32_t heur_f(node_t n) {
+		return (pot_f(n) + pot_r(target) - pot_r(n)) / 2;
+	}
+
+	uint32_t heur_r(node_t n) {
+		return (pot_r(n) + pot_f(source) - pot_f(n)) / 2;
+	}
 
+	// A node is marked as closed before its arcs are scanned. Both marks and lookups are sequentially
+	// consistent, so if both searches scan an arc between their search spaces at the same time, at
+	// least one of them sees the other side as closed.
 	void step_f() {
 		IDKeyPair best = q_f.pop();
 		closed_f.set(best.id);
+		uint32_t best_dist = dist_f.get(best.id);
 		const auto& arcs = g.get_out_arcs(best.id);
-		for (const Edge& arc : arcs) {
-			uint32_t g = dist_f.get(best.id) + arc.weight;
-			if (g + pot_f1(arc.target) >= tentative_dist) { // Pruning
+		count_settled(StatsScope::BIDIRECTIONAL_ASTAR);
+		count_relaxed(StatsScope::BIDIRECTIONAL_ASTAR, arcs.size());
+		for (uint32_t i = 0; i < arcs.size(); i++) {
+			Edge arc = arcs[i];
+			uint32_t g = best_dist + arc.weight;
+			if (g + pot_f(arc.target) >= get_tentative_dist()) { // Pruning
 				continue;
 			}
-			if (closed_r.has(arc.target) && g + dist_r.get(arc.target) < tentative_dist) {
-				tentative_dist = g + dist_r.get(arc.target);
-				best_node = arc.target;
+			if (closed_r.has(arc.target)) {
+				update_meeting(g + dist_r.get(arc.target), arc.target);
 			}
 			if (g < dist_f.get(arc.target)) {
 				dist_f.set(arc.target, g);
 				par_f.set(arc.target, best.id);
-				uint32_t k = dist_f.get(arc.target) + heur_f1(arc.target);
+				par_arc_f.set(arc.target, this->g.get_out_arc_id(best.id, i));
+				uint32_t k = g + heur_f(arc.target);
 				if (q_f.contains_id(arc.target)) {
 					q_f.decrease_key({ arc.target, k });
+					count_decrease_key(StatsScope::BIDIRECTIONAL_ASTAR);
 				} else {
 					q_f.push({ arc.target, k });
+					count_push(StatsScope::BIDIRECTIONAL_ASTAR);
 				}
 			}
 		}
@@ -177,105 +222,158 @@ private:
 	void step_r() {
 		IDKeyPair best = q_r.pop();
 		closed_r.set(best.id);
+		uint32_t best_dist = dist_r.get(best.id);
 		const auto& arcs = g.get_rev_out_arcs(best.id);
-		for (const Edge& arc : arcs) {
-			uint32_t g = dist_r.get(best.id) + arc.weight;
-			if (g + pot_r2(arc.target) >= tentative_dist) { // Pruning
+		count_settled(StatsScope::BIDIRECTIONAL_ASTAR);
+		count_relaxed(StatsScope::BIDIRECTIONAL_ASTAR, arcs.size());
+		for (uint32_t i = 0; i < arcs.size(); i++) {
+			Edge arc = arcs[i];
+			uint32_t g = best_dist + arc.weight;
+			if (g + pot_r(arc.target) >= get_tentative_dist()) { // Pruning
 				continue;
 			}
-			if (closed_f.has(arc.target) && g + dist_f.get(arc.target) < tentative_dist) {
-				tentative_dist = g + dist_f.get(arc.target);
-				best_node = arc.target;
+			if (closed_f.has(arc.target)) {
+				update_meeting(g + dist_f.get(arc.target), arc.target);
 			}
 			if (g < dist_r.get(arc.target)) {
 				dist_r.set(arc.target, g);
 				par_r.set(arc.target, best.id);
-				uint32_t k = dist_r.get(arc.target) + heur_r2(arc.target);
+				par_arc_r.set(arc.target, this->g.get_rev_out_arc_id(best.id, i));
+				uint32_t k = g + heur_r(arc.target);
 				if (q_r.contains_id(arc.target)) {
 					q_r.decrease_key({ arc.target, k });
+					count_decrease_key(StatsScope::BIDIRECTIONAL_ASTAR);
 				} else {
 					q_r.push({ arc.target, k });
+					count_push(StatsScope::BIDIRECTIONAL_ASTAR);
 				}
 			}
 		}
 	}
 
+	// Both threads stop as soon as k_f + k_r >= tentative_dist + stop_offset. All values only grow
+	// or shrink monotonically towards this point, so once one thread sees it, it stays true.
+	bool should_stop() const {
+		return (uint64_t)k_f.load() + k_r.load() >= (uint64_t)get_tentative_dist() + stop_offset;
+	}
+
 	void thread_function_f() {
-		while (k_f + k_r < tentative_dist + heur_f1(source)) {
+		while (!q_f.empty() && !should_stop()) {
 			step_f();
-			if (!q_f.empty()) {
-				k_f = q_f.peek().key;
-			} else {
-				k_f = inf_weight;
-			}
+			k_f.store(q_f.empty() ? inf_weight : q_f.peek().key);
+		}
+		k_f.store(inf_weight);
+		if constexpr (search_stats_enabled) {
+			stats_f = global_search_stats;
 		}
 	}
 
 	void thread_function_r() {
-		while (k_f + k_r < tentative_dist + heur_f2(source)) {
+		while (!q_r.empty() && !should_stop()) {
 			step_r();
-			if (!q_r.empty()) {
-				k_r = q_r.peek().key;
+			k_r.store(q_r.empty() ? inf_weight : q_r.peek().key);
+		}
+		k_r.store(inf_weight);
+		if constexpr (search_stats_enabled) {
+			stats_r = global_search_stats;
+		}
+	}
+
+	void run_interleaved() {
+		while (!should_stop()) {
+			if (!q_f.empty() && (q_r.empty() || k_f.load() <= k_r.load())) {
+				step_f();
+				k_f.store(q_f.empty() ? inf_weight : q_f.peek().key);
+			} else if (!q_r.empty()) {
+				step_r();
+				k_r.store(q_r.empty() ? inf_weight : q_r.peek().key);
 			} else {
-				k_r = inf_weight;
+				break;
 			}
 		}
 	}
 
 	Path get_path() {
-		Path ret = { std::vector<node_t>(), tentative_dist };
+		node_t best_node = get_best_node();
+		if (best_node == invalid_id) {
+			return { std::vector<node_t>(), inf_weight, std::vector<uint32_t>() };
+		}
+		Path ret = { std::vector<node_t>(), dist_f.get(best_node) + dist_r.get(best_node), std::vector<uint32_t>() };
 		node_t current = best_node;
 		while (current != invalid_id) {
 			ret.nodes.push_back(current);
+			if (current != source) {
+				ret.edges.push_back(par_arc_f.get(current));
+			}
 			current = par_f.get(current);
 		}
 		std::reverse(ret.nodes.begin(), ret.nodes.end());
+		std::reverse(ret.edges.begin(), ret.edges.end());
 		current = best_node;
-		while (current != invalid_id) {
+		while (current != target) {
+			ret.edges.push_back(par_arc_r.get(current));
 			current = par_r.get(current);
 			ret.nodes.push_back(current);
 		}
-		ret.nodes.pop_back();
 		return ret;
 	}
 
 
 public:
 
-	BidirectionalAStarService(const Graph& g, const ContractionHierarchy& ch) :
+	BidirectionalAStarService(const GraphT& g, const ContractionHierarchy& ch, PotentialMode potential_mode = PotentialMode::LAZY, BidirectionalMode mode = BidirectionalMode::PARALLEL) :
 		g(g), 
-		pot_f1(ch), pot_r1(ch), pot_f2(ch), pot_r2(ch),
-		q_f(g.size()), q_r(g.size()),
+		mode(mode),
+		pot_f(ch, potential_mode), pot_r(ch, potential_mode),
 		closed_f(g.size()), closed_r(g.size()),
+		q_f(g.size()), q_r(g.size()),
 		dist_f(g.size(), inf_weight), dist_r(g.size(), inf_weight),
 		par_f(g.size(), invalid_id), par_r(g.size(), invalid_id),
-		locks(g.size())
+		par_arc_f(g.size(), invalid_id), par_arc_r(g.size(), invalid_id),
+		meeting(pack_meeting(inf_weight, invalid_id)),
+		k_f(0), k_r(0)
 	{
 
 	}
 
+	// Passes a changed arc of the CH used for the potentials on to both potentials. The CH graphs
+	// themselves must already contain the new weights.
+	void update_potential_arc(node_t tail, uint32_t i, uint32_t forward_weight, uint32_t backward_weight) {
+		pot_f.set_upward_arc_weight(tail, i, forward_weight);
+		pot_r.set_upward_arc_weight(tail, i, backward_weight);
+	}
+
 	Path run(node_t source, node_t target) {
 		this->source = source;
 		this->target = target;
-		pot_f1.set_target(target);
-		pot_f2.set_target(target);
-		pot_r1.set_target(source);
-		pot_r2.set_target(source);
+		pot_f.set_target(target);
+		pot_r.set_target(source);
 		dist_f.set(source, 0);
 		dist_r.set(target, 0);
 		par_f.set(source, invalid_id);
 		par_r.set(target, invalid_id);
-		q_f.push({ source, heur_f1(source) });
-		q_r.push({ target, heur_r1(target) });
-		min_key_f = heur_f1(source);
+		stop_offset = heur_f(source);
+		q_f.push({ source, heur_f(source) });
+		q_r.push({ target, heur_r(target) });
 		closed_f.set(source);
 		closed_r.set(target);
-		k_f = heur_f1(source);
-		k_r = heur_r1(target);
-		std::thread thread_f(&BidirectionalAStarService::thread_function_f, this);
-		std::thread thread_r(&BidirectionalAStarService::thread_function_r, this);
-		thread_f.join();
-		thread_r.join();
+		if (source == target) {
+			update_meeting(0, source);
+		}
+		k_f.store(heur_f(source));
+		k_r.store(heur_r(target));
+		if (mode == BidirectionalMode::PARALLEL) {
+			std::thread thread_f(&BidirectionalAStarService::thread_function_f, this);
+			std::thread thread_r(&BidirectionalAStarService::thread_function_r, this);
+			thread_f.join();
+			thread_r.join();
+			if constexpr (search_stats_enabled) {
+				global_search_stats.add(stats_f);
+				global_search_stats.add(stats_r);
+			}
+		} else {
+			run_interleaved();
+		}
 		global_performance_logger.log_iteration_astar_search_space(closed_f.size() + closed_r.size());
 		Path ret = get_path();
 		// Cleanup
@@ -283,12 +381,13 @@ public:
 		dist_r.step_time();
 		par_f.step_time();
 		par_r.step_time();
+		par_arc_f.step_time();
+		par_arc_r.step_time();
 		q_f.clear();
 		q_r.clear();
 		closed_f.clear();
 		closed_r.clear();
-		tentative_dist = inf_weight;
-		best_node = invalid_id;
+		meeting.store(pack_meeting(inf_weight, invalid_id));
 		return ret;
 	}
 
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "graph.h"
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+// Set of node ids that one thread inserts into while other threads query it. Bits are packed into
+// 64 bit words that are updated with fetch_or. set, clear, begin/end and size are for the owning
+// thread only, clear must not run concurrently with has.
+class AtomicBitSet {
+
+private:
+	std::unique_ptr<std::atomic<uint64_t>[]> words;
+	std::vector<node_t> delete_list;
+
+
+public:
+
+	AtomicBitSet(uint32_t size) : words(new std::atomic<uint64_t>[(size + 63) / 64]) {
+		for (uint32_t i = 0; i < (size + 63) / 64; i++) {
+			words[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	void set(node_t id) {
+		uint64_t bit = (uint64_t)1 << (id % 64);
+		if ((words[id / 64].fetch_or(bit) & bit) == 0) {
+			delete_list.push_back(id);
+		}
+	}
+
+	bool has(node_t id) const {
+		return (words[id / 64].load() >> (id % 64)) & 1;
+	}
+
+	void clear() {
+		for (node_t id : delete_list) {
+			words[id / 64].store(0, std::memory_order_relaxed);
+		}
+		delete_list.clear();
+	}
+
+	std::vector<node_t>::iterator begin() {
+		return delete_list.begin();
+	}
+
+	std::vector<node_t>::iterator end() {
+		return delete_list.end();
+	}
+
+	uint32_t size() const {
+		return delete_list.size();
+	}
+
+};
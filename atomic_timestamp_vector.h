@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <ctype.h>
+
+// TimestampVector for 32 bit values that one thread writes while other threads read it. Value and
+// timestamp share one atomic word, so a reader never sees a value together with a stale timestamp.
+// step_time must not run concurrently with get or set.
+class AtomicTimestampVector {
+
+	private:
+		std::unique_ptr<std::atomic<uint64_t>[]> vec;
+		uint32_t size;
+		uint32_t default_value;
+		uint32_t t = 0;
+
+
+	public:
+		AtomicTimestampVector(uint32_t size, uint32_t default_value) : vec(new std::atomic<uint64_t>[size]), size(size), default_value(default_value) {
+			for (uint32_t i = 0; i < size; i++) {
+				vec[i].store(0, std::memory_order_relaxed);
+			}
+			step_time();
+		}
+
+		void set(uint32_t index, uint32_t value) {
+			vec[index].store(((uint64_t)t << 32) | value, std::memory_order_release);
+		}
+
+		uint32_t get(uint32_t index) const {
+			uint64_t word = vec[index].load(std::memory_order_acquire);
+			return (word >> 32) == t ? (uint32_t)word : default_value;
+		}
+
+		bool has(uint32_t index) const {
+			return (vec[index].load(std::memory_order_acquire) >> 32) == t;
+		}
+
+		void step_time() {
+			t++;
+			if (t == 0) { // Overflow, old entries could become valid again
+				for (uint32_t i = 0; i < size; i++) {
+					vec[i].store(0, std::memory_order_relaxed);
+				}
+				t = 1;
+			}
+		}
+
+
+};
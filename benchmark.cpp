@@ -0,0 +1,539 @@
+#define NOMINMAX
+
+#include <cxxopts.hpp>
+#include <aixlog.hpp>
+#include "graph.h"
+#include "static_graph.h"
+#include "loader.h"
+#include "dijkstra.h"
+#include "id_queue.h"
+#include "radix_heap.h"
+#include "multi_level_bucket_queue.h"
+#include "contraction.h"
+#include "potentials.h"
+#include "astar.h"
+#include "penalty.h"
+#include "xbdv.h"
+#include "util.h"
+#include "timer.h"
+#include <iostream>
+#include <random>
+#include <string>
+#include <algorithm>
+
+// Arcs of a grid graph with random weights in [1, 100] in both directions. Used when no real graph is given.
+std::vector<std::pair<node_t, Edge>> make_grid_edges(uint32_t width, uint32_t height, uint32_t seed) {
+	std::mt19937 generator(seed);
+	std::uniform_int_distribution<uint32_t> distribution(1, 100);
+	std::vector<std::pair<node_t, Edge>> edges;
+	for (uint32_t y = 0; y < height; y++) {
+		for (uint32_t x = 0; x < width; x++) {
+			node_t n = y * width + x;
+			if (x + 1 < width) {
+				edges.push_back(std::make_pair(n, Edge{ n + 1, distribution(generator) }));
+				edges.push_back(std::make_pair(n + 1, Edge{ n, distribution(generator) }));
+			}
+			if (y + 1 < height) {
+				edges.push_back(std::make_pair(n, Edge{ n + width, distribution(generator) }));
+				edges.push_back(std::make_pair(n + width, Edge{ n, distribution(generator) }));
+			}
+		}
+	}
+	return edges;
+}
+
+StaticGraph make_grid_graph(uint32_t width, uint32_t height, uint32_t seed) {
+	return StaticGraph(width * height, make_grid_edges(width, height, seed));
+}
+
+// Nested dissection order of a grid: The middle column or row of a rectangle is contracted after
+// both halves, recursively. Gives a small CH without an expensive node ordering.
+void append_grid_order(uint32_t width, uint32_t x0, uint32_t x1, uint32_t y0, uint32_t y1, std::vector<node_t>& order) {
+	if (x0 >= x1 || y0 >= y1) {
+		return;
+	}
+	if (x1 - x0 >= y1 - y0) {
+		uint32_t mid = (x0 + x1) / 2;
+		append_grid_order(width, x0, mid, y0, y1, order);
+		append_grid_order(width, mid + 1, x1, y0, y1, order);
+		for (uint32_t y = y0; y < y1; y++) {
+			order.push_back(y * width + mid);
+		}
+	} else {
+		uint32_t mid = (y0 + y1) / 2;
+		append_grid_order(width, x0, x1, y0, mid, order);
+		append_grid_order(width, x0, x1, mid + 1, y1, order);
+		for (uint32_t x = x0; x < x1; x++) {
+			order.push_back(mid * width + x);
+		}
+	}
+}
+
+ContractionHierarchy make_grid_ch(uint32_t width, uint32_t height, uint32_t seed) {
+	Graph g(width * height);
+	for (const auto& e : make_grid_edges(width, height, seed)) {
+		g.add_edge(e.first, e.second);
+	}
+	std::vector<node_t> order;
+	append_grid_order(width, 0, width, 0, height, order);
+	return contract_graph(g, order);
+}
+
+std::vector<node_t> get_random_nodes(uint32_t n, uint32_t graph_size, uint32_t seed) {
+	std::mt19937 generator(seed);
+	std::uniform_int_distribution<uint32_t> distribution(0, graph_size - 1);
+	std::vector<node_t> ret;
+	for (uint32_t i = 0; i < n; i++) {
+		ret.push_back(distribution(generator));
+	}
+	return ret;
+}
+
+// Runs a full one-to-all Dijkstra from every source and prints one CSV line:
+// queue, queries, total time (mus), average time per query (mus), pops per second
+template <class QueueT>
+void benchmark_queue(const std::string& name, const StaticGraph& g, const std::vector<node_t>& sources) {
+	DijkstraService<StaticGraph, QueueT> dijkstra(g);
+	Timer timer;
+	long long total_time = 0;
+	uint64_t settled = 0;
+	for (node_t s : sources) {
+		dijkstra.set_source(s);
+		timer.lap();
+		dijkstra.run_until_done();
+		total_time += timer.get();
+		settled += dijkstra.get_search_space().size();
+		dijkstra.finish();
+	}
+	double seconds = total_time / 1e6;
+	std::cout << name << "," << sources.size() << "," << total_time << "," << total_time / (double)sources.size() << "," << (uint64_t)(settled / seconds) << "\n";
+}
+
+StaticGraph load_benchmark_graph(const cxxopts::ParseResult& parse_result) {
+	if (parse_result.count("input") != 0) {
+		std::string input_path = parse_result["input"].as<std::string>();
+		if (input_path.back() != '/') {
+			input_path.push_back('/');
+		}
+		return read_graph(input_path);
+	}
+	uint32_t grid_size = (parse_result.count("grid-size") != 0) ? parse_result["grid-size"].as<uint32_t>() : 1000;
+	LOG(INFO) << "No input graph given, using " << grid_size << "x" << grid_size << " grid\n";
+	return make_grid_graph(grid_size, grid_size, 1);
+}
+
+struct STPair {
+	node_t source;
+	node_t target;
+};
+
+// Runs every query once and prints one CSV line: engine, workload, queries, mean, median, 90th and
+// 99th percentile and maximum time per query (mus), queries per second and the sum of the query
+// results, so engines that compute the same thing can be compared.
+template <class F>
+void benchmark_engine(const std::string& engine, const std::string& workload, const std::vector<STPair>& pairs, F query) {
+	if (pairs.empty()) {
+		return;
+	}
+	std::vector<long long> times;
+	uint64_t checksum = 0;
+	Timer timer;
+	for (const STPair& p : pairs) {
+		timer.lap();
+		checksum += query(p.source, p.target);
+		times.push_back(timer.get());
+	}
+	std::sort(times.begin(), times.end());
+	long long total_time = 0;
+	for (long long t : times) {
+		total_time += t;
+	}
+	auto percentile = [&times](double p) {
+		return times[std::min(times.size() - 1, (size_t)(p * times.size()))];
+	};
+	double qps = total_time > 0 ? pairs.size() / (total_time / 1e6) : 0;
+	std::cout << engine << "," << workload << "," << pairs.size() << "," << total_time / (double)pairs.size() << ",";
+	std::cout << percentile(0.5) << "," << percentile(0.9) << "," << percentile(0.99) << "," << times.back() << ",";
+	std::cout << qps << "," << checksum << "\n";
+}
+
+template <class F>
+void benchmark_engine(const std::string& engine, const std::vector<std::pair<std::string, std::vector<STPair>>>& workloads, F query) {
+	for (const auto& workload : workloads) {
+		benchmark_engine(engine, workload.first, workload.second, query);
+	}
+}
+
+// Runs the first query of pairs repeat times on one service. The result and the state the service keeps
+// between queries (retained) must stay the same, otherwise later queries of a workload are measured
+// with a growing footprint.
+template <class F, class G>
+bool check_repeated_query(const std::string& engine, const std::vector<STPair>& pairs, uint32_t repeat, F query, G retained) {
+	if (pairs.empty()) {
+		return true;
+	}
+	const STPair& pair = pairs[0];
+	uint32_t first_result = query(pair.source, pair.target);
+	size_t first_retained = retained();
+	for (uint32_t i = 1; i < repeat; i++) {
+		if (query(pair.source, pair.target) != first_result || retained() != first_retained) {
+			LOG(ERROR) << engine << ": repeated query " << pair.source << " -> " << pair.target << " changed result or footprint after " << i << " repetitions\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+// Random pairs, and for some random sources the targets of Dijkstra rank 2^0, 2^1, ... (one workload per rank)
+std::vector<std::pair<std::string, std::vector<STPair>>> get_workloads(const StaticGraph& g, uint32_t queries, uint32_t rank_sources, uint32_t seed) {
+	std::vector<std::pair<std::string, std::vector<STPair>>> workloads;
+	std::vector<node_t> sources = get_random_nodes(queries, g.size(), seed);
+	std::vector<node_t> targets = get_random_nodes(queries, g.size(), seed + 1);
+	std::vector<STPair> random_pairs;
+	for (uint32_t i = 0; i < queries; i++) {
+		random_pairs.push_back({ sources[i], targets[i] });
+	}
+	workloads.push_back(std::make_pair(std::string("random"), random_pairs));
+	std::vector<std::vector<STPair>> rank_pairs;
+	for (node_t s : get_random_nodes(rank_sources, g.size(), seed + 2)) {
+		std::vector<node_t> rank_targets = get_dijkstra_rank_nodes(g, s);
+		for (uint32_t r = 0; r < rank_targets.size(); r++) {
+			if (rank_pairs.size() <= r) {
+				rank_pairs.resize(r + 1);
+			}
+			rank_pairs[r].push_back({ s, rank_targets[r] });
+		}
+	}
+	for (uint32_t r = 0; r < rank_pairs.size(); r++) {
+		workloads.push_back(std::make_pair("rank_" + std::to_string(1u << r), rank_pairs[r]));
+	}
+	return workloads;
+}
+
+int run_engine_benchmark(int argn, char** argv) {
+	cxxopts::Options options("CH-Potentials-Penalty-Benchmark", "Measures all search engines on random and Dijkstra rank queries.");
+	options.add_options()
+		("i,input", "Path to input folder with graph and ch/. Default: synthetic grid graph with built-in CH", cxxopts::value<std::string>())
+		("queries", "Number of random queries (default: 100)", cxxopts::value<uint32_t>())
+		("rank-sources", "Number of sources for the Dijkstra rank queries (default: 10)", cxxopts::value<uint32_t>())
+		("grid-size", "Side length of the synthetic grid graph (default: 100)", cxxopts::value<uint32_t>())
+		("seed", "Seed for the query nodes (default: 42)", cxxopts::value<uint32_t>())
+		("engines", "Comma separated engines to run (default: all)", cxxopts::value<std::string>())
+	;
+	auto parse_result = options.parse(argn, argv);
+	uint32_t queries = (parse_result.count("queries") != 0) ? parse_result["queries"].as<uint32_t>() : 100;
+	uint32_t rank_sources = (parse_result.count("rank-sources") != 0) ? parse_result["rank-sources"].as<uint32_t>() : 10;
+	uint32_t seed = (parse_result.count("seed") != 0) ? parse_result["seed"].as<uint32_t>() : 42;
+	std::string engines = (parse_result.count("engines") != 0) ? "," + parse_result["engines"].as<std::string>() + "," : "";
+	auto is_selected = [&engines](const std::string& engine) {
+		return engines.empty() || engines.find("," + engine + ",") != std::string::npos;
+	};
+	StaticGraph g;
+	ContractionHierarchy ch;
+	if (parse_result.count("input") != 0) {
+		std::string input_path = parse_result["input"].as<std::string>();
+		if (input_path.back() != '/') {
+			input_path.push_back('/');
+		}
+		g = read_graph(input_path, true);
+		ch = read_ch(input_path + "ch/", g);
+	} else {
+		uint32_t grid_size = (parse_result.count("grid-size") != 0) ? parse_result["grid-size"].as<uint32_t>() : 100;
+		LOG(INFO) << "No input graph given, using " << grid_size << "x" << grid_size << " grid with built-in CH\n";
+		g = make_grid_graph(grid_size, grid_size, 1);
+		ch = make_grid_ch(grid_size, grid_size, 1);
+	}
+	auto workloads = get_workloads(g, queries, rank_sources, seed);
+	std::cout << "engine,workload,queries,mean_time,p50_time,p90_time,p99_time,max_time,queries_per_second,checksum\n";
+	if (is_selected("dijkstra")) {
+		DijkstraService<StaticGraph> dijkstra(g);
+		benchmark_engine("dijkstra", workloads, [&](node_t s, node_t t) {
+			dijkstra.set_source(s);
+			dijkstra.run_until_target_found(t);
+			uint32_t dist = dijkstra.get_dist(t);
+			dijkstra.finish();
+			return dist;
+		});
+	}
+	if (is_selected("ch_query")) {
+		CHQueryService<> ch_query(g, ch);
+		auto query = [&](node_t s, node_t t) {
+			return ch_query.query(s, t);
+		};
+		if (!check_repeated_query("ch_query", workloads[0].second, 100, query, [&]() { return ch_query.get_retained_nodes(); })) {
+			return 1;
+		}
+		benchmark_engine("ch_query", workloads, query);
+	}
+	if (is_selected("ch_path")) {
+		if (!ch.has_middle_nodes()) {
+			compute_middle_nodes(ch, g);
+		}
+		CHQueryService<> ch_query(g, ch);
+		auto query = [&](node_t s, node_t t) {
+			return ch_query.query_path(s, t).length;
+		};
+		if (!check_repeated_query("ch_path", workloads[0].second, 100, query, [&]() { return ch_query.get_retained_nodes(); })) {
+			return 1;
+		}
+		benchmark_engine("ch_path", workloads, query);
+		LOG(INFO) << "Unpacking cache hits: " << ch_query.get_unpacker().get_cache_hits() << ", misses: " << ch_query.get_unpacker().get_cache_misses() << "\n";
+	}
+	if (is_selected("dijkstra_on_ch")) {
+		DijkstraService<StaticGraph> forward_service(ch.forward_graph);
+		DijkstraService<StaticGraph> backward_service(ch.backward_graph);
+		benchmark_engine("dijkstra_on_ch", workloads, [&](node_t s, node_t t) {
+			return dijkstra_on_ch(s, t, forward_service, backward_service, g.size(), false).length;
+		});
+	}
+	if (is_selected("astar_ch")) {
+		CHPotentialService potential(ch);
+		AStarService<StaticGraph> astar(g, potential);
+		benchmark_engine("astar_ch", workloads, [&](node_t s, node_t t) {
+			potential.set_target(t);
+			astar.add_source(s);
+			astar.run_until_target_found(t);
+			uint32_t dist = astar.get_dist(t);
+			astar.finish();
+			return dist;
+		});
+	}
+	if (is_selected("bidirectional_astar")) {
+		BidirectionalAStarService<StaticGraph> astar(g, ch, PotentialMode::LAZY, BidirectionalMode::PARALLEL);
+		benchmark_engine("bidirectional_astar", workloads, [&](node_t s, node_t t) {
+			return astar.run(s, t).length;
+		});
+	}
+	if (is_selected("bidirectional_astar_interleaved")) {
+		BidirectionalAStarService<StaticGraph> astar(g, ch, PotentialMode::LAZY, BidirectionalMode::INTERLEAVED);
+		benchmark_engine("bidirectional_astar_interleaved", workloads, [&](node_t s, node_t t) {
+			return astar.run(s, t).length;
+		});
+	}
+	if (is_selected("penalty")) {
+		PenaltyService penalty(g, ch);
+		benchmark_engine("penalty", workloads, [&](node_t s, node_t t) {
+			penalty.set_source(s);
+			penalty.set_target(t);
+			penalty.run();
+			uint32_t arcs = penalty.get_alt_graph().get_edges().size();
+			penalty.reset();
+			return arcs;
+		});
+	}
+	if (is_selected("xbdv")) {
+		XBDVService<StaticGraph> xbdv(g);
+		benchmark_engine("xbdv", workloads, [&](node_t s, node_t t) {
+			return (uint32_t)xbdv.run_bdv(s, t).size();
+		});
+	}
+	return 0;
+}
+
+// Contracts the graph with contract_parallel for every thread count and prints one CSV line per run:
+// threads, witness limits, time (ms), shortcuts, upward and downward arcs of the CH. Witness search
+// stats are logged.
+int run_contraction_benchmark(int argn, char** argv) {
+	cxxopts::Options options("CH-Potentials-Penalty-Benchmark", "Measures parallel contraction with different numbers of threads.");
+	options.add_options()
+		("i,input", "Path to input folder. Default: synthetic grid graph", cxxopts::value<std::string>())
+		("grid-size", "Side length of the synthetic grid graph (default: 300)", cxxopts::value<uint32_t>())
+		("threads", "Comma separated thread counts (default: 1 and all cores)", cxxopts::value<std::string>())
+		("hop-limit", "Maximum number of arcs of a witness path (default: unlimited)", cxxopts::value<uint32_t>())
+		("settle-limit", "Maximum number of settled nodes per witness search (default: unlimited)", cxxopts::value<uint32_t>())
+	;
+	auto parse_result = options.parse(argn, argv);
+	Graph g(0);
+	if (parse_result.count("input") != 0) {
+		std::string input_path = parse_result["input"].as<std::string>();
+		if (input_path.back() != '/') {
+			input_path.push_back('/');
+		}
+		g = Graph(read_graph(input_path));
+	} else {
+		uint32_t grid_size = (parse_result.count("grid-size") != 0) ? parse_result["grid-size"].as<uint32_t>() : 300;
+		LOG(INFO) << "No input graph given, using " << grid_size << "x" << grid_size << " grid\n";
+		g = Graph(grid_size * grid_size);
+		for (const auto& e : make_grid_edges(grid_size, grid_size, 1)) {
+			g.add_edge(e.first, e.second);
+		}
+	}
+	std::vector<uint32_t> thread_counts;
+	if (parse_result.count("threads") != 0) {
+		std::string list = parse_result["threads"].as<std::string>();
+		size_t pos = 0;
+		while (pos < list.size()) {
+			size_t end = list.find(',', pos);
+			end = (end == std::string::npos) ? list.size() : end;
+			thread_counts.push_back(std::stoul(list.substr(pos, end - pos)));
+			pos = end + 1;
+		}
+	} else {
+		thread_counts = { 1, std::max(1u, std::thread::hardware_concurrency()) };
+	}
+	WitnessLimits limits;
+	if (parse_result.count("hop-limit") != 0) {
+		limits.max_hops = parse_result["hop-limit"].as<uint32_t>();
+	}
+	if (parse_result.count("settle-limit") != 0) {
+		limits.max_settled = parse_result["settle-limit"].as<uint32_t>();
+	}
+	auto limit_to_string = [](uint32_t limit) {
+		return limit == inf_weight ? std::string("none") : std::to_string(limit);
+	};
+	uint32_t input_arcs = g.n_edges();
+	std::cout << "threads,hop_limit,settle_limit,time,shortcuts,up_arcs,down_arcs\n";
+	for (uint32_t threads : thread_counts) {
+		Timer timer;
+		timer.lap();
+		ContractionHierarchy ch = contract_parallel(g, std::max(1u, threads), limits);
+		long long time = timer.get() / 1000;
+		uint32_t ch_arcs = ch.forward_graph.n_edges() + ch.backward_graph.n_edges();
+		std::cout << threads << "," << limit_to_string(limits.max_hops) << "," << limit_to_string(limits.max_settled) << "," << time << ",";
+		std::cout << ch_arcs - input_arcs << "," << ch.forward_graph.n_edges() << "," << ch.backward_graph.n_edges() << "\n";
+	}
+	return 0;
+}
+
+// Compares CH queries on the current metric of cch with Dijkstra on g, which must have the same weights.
+bool check_cch_queries(const StaticGraph& g, const CustomizableCH& cch, const std::vector<STPair>& pairs) {
+	CHQueryService<> ch_query(g, cch.get_ch());
+	DijkstraService<StaticGraph> dijkstra(g);
+	for (const STPair& p : pairs) {
+		dijkstra.set_source(p.source);
+		dijkstra.run_until_target_found(p.target);
+		uint32_t dist = dijkstra.get_dist(p.target);
+		dijkstra.finish();
+		if (ch_query.query(p.source, p.target) != dist) {
+			LOG(ERROR) << "CCH query " << p.source << " -> " << p.target << " differs from Dijkstra (" << dist << ")\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+// Checks the metric of a fresh CustomizableCH, after doubling the weights of a tenth of the input arcs
+// with partial customization, and after reset.
+bool check_cch(const StaticGraph& g, const CCHTopology& topology, const std::vector<STPair>& pairs, uint32_t seed) {
+	CustomizableCH cch(topology);
+	if (!check_cch_queries(g, cch, pairs)) {
+		return false;
+	}
+	StaticGraph changed = g;
+	std::default_random_engine generator(seed);
+	std::uniform_int_distribution<uint32_t> distribution(0, g.n_edges() - 1);
+	for (uint32_t i = 0; i < g.n_edges() / 10; i++) {
+		uint32_t arc = distribution(generator);
+		uint32_t weight = 2 * changed.get_arc_weight(arc);
+		changed.set_arc_weight(arc, weight);
+		cch.set_input_weight(arc, weight);
+	}
+	cch.update();
+	if (!check_cch_queries(changed, cch, pairs)) {
+		return false;
+	}
+	cch.reset();
+	return check_cch_queries(g, cch, pairs);
+}
+
+// Builds a CCH with a nested dissection order and one with the order of contract_parallel and prints
+// one CSV line per order: order, status, time (ms) to build and customize the topology, arcs and
+// lower triangles of the CCH. The status is refused if the fill-in of the order is too large, else
+// the CCH is checked against Dijkstra (see check_cch) and the status is ok or wrong.
+int run_cch_benchmark(int argn, char** argv) {
+	cxxopts::Options options("CH-Potentials-Penalty-Benchmark", "Builds and checks CCHs with different node orders.");
+	options.add_options()
+		("i,input", "Path to input folder. Default: synthetic grid graph", cxxopts::value<std::string>())
+		("grid-size", "Side length of the synthetic grid graph (default: 80)", cxxopts::value<uint32_t>())
+		("queries", "Number of random queries per check (default: 100)", cxxopts::value<uint32_t>())
+		("threads", "Number of threads for contract_parallel (default: all cores)", cxxopts::value<uint32_t>())
+		("seed", "Seed for the query nodes and the changed arcs (default: 42)", cxxopts::value<uint32_t>())
+	;
+	auto parse_result = options.parse(argn, argv);
+	uint32_t queries = (parse_result.count("queries") != 0) ? parse_result["queries"].as<uint32_t>() : 100;
+	uint32_t threads = (parse_result.count("threads") != 0) ? parse_result["threads"].as<uint32_t>() : std::thread::hardware_concurrency();
+	uint32_t seed = (parse_result.count("seed") != 0) ? parse_result["seed"].as<uint32_t>() : 42;
+	StaticGraph g;
+	if (parse_result.count("input") != 0) {
+		std::string input_path = parse_result["input"].as<std::string>();
+		if (input_path.back() != '/') {
+			input_path.push_back('/');
+		}
+		g = read_graph(input_path);
+	} else {
+		uint32_t grid_size = (parse_result.count("grid-size") != 0) ? parse_result["grid-size"].as<uint32_t>() : 80;
+		LOG(INFO) << "No input graph given, using " << grid_size << "x" << grid_size << " grid\n";
+		g = make_grid_graph(grid_size, grid_size, 1);
+	}
+	std::vector<std::pair<std::string, std::vector<uint32_t>>> orders;
+	orders.push_back(std::make_pair(std::string("nested_dissection"), compute_nested_dissection_ranking(g)));
+	orders.push_back(std::make_pair(std::string("contraction"), contract_parallel(Graph(g), std::max(1u, threads)).ranking));
+	std::vector<node_t> sources = get_random_nodes(queries, g.size(), seed);
+	std::vector<node_t> targets = get_random_nodes(queries, g.size(), seed + 1);
+	std::vector<STPair> pairs;
+	for (uint32_t i = 0; i < queries; i++) {
+		pairs.push_back({ sources[i], targets[i] });
+	}
+	bool all_correct = true;
+	std::cout << "order,status,time,arcs,triangles\n";
+	for (const auto& order : orders) {
+		Timer timer;
+		timer.lap();
+		std::unique_ptr<CCHTopology> topology;
+		try {
+			topology.reset(new CCHTopology(g, order.second));
+		} catch (const std::runtime_error& e) {
+			LOG(INFO) << e.what() << "\n";
+			std::cout << order.first << ",refused," << timer.get() / 1000 << ",,\n";
+			continue;
+		}
+		long long time = timer.get() / 1000;
+		bool correct = check_cch(g, *topology, pairs, seed);
+		all_correct = all_correct && correct;
+		std::cout << order.first << "," << (correct ? "ok" : "wrong") << "," << time << "," << topology->n_arcs() << "," << topology->triangles << "\n";
+	}
+	return all_correct ? 0 : 1;
+}
+
+int run_queue_benchmark(int argn, char** argv) {
+	cxxopts::Options options("CH-Potentials-Penalty-Benchmark", "Compares priority queue implementations on full Dijkstra searches.");
+	options.add_options()
+		("i,input", "Path to input folder. Default: synthetic grid graph", cxxopts::value<std::string>())
+		("queries", "Number of searches per queue (default: 20)", cxxopts::value<uint32_t>())
+		("grid-size", "Side length of the synthetic grid graph (default: 1000)", cxxopts::value<uint32_t>())
+		("seed", "Seed for the source nodes (default: 42)", cxxopts::value<uint32_t>())
+	;
+	auto parse_result = options.parse(argn, argv);
+	uint32_t queries = (parse_result.count("queries") != 0) ? parse_result["queries"].as<uint32_t>() : 20;
+	uint32_t seed = (parse_result.count("seed") != 0) ? parse_result["seed"].as<uint32_t>() : 42;
+	StaticGraph g = load_benchmark_graph(parse_result);
+	std::vector<node_t> sources = get_random_nodes(queries, g.size(), seed);
+	std::cout << "queue,queries,total_time,avg_time,pops_per_second\n";
+	benchmark_queue<KaryIDQueue<2>>("binary_heap", g, sources);
+	benchmark_queue<KaryIDQueue<4>>("4_heap", g, sources);
+	benchmark_queue<KaryIDQueue<8>>("8_heap", g, sources);
+	benchmark_queue<RadixIDQueue>("radix_heap", g, sources);
+	benchmark_queue<MultiLevelBucketQueue<>>("multi_level_buckets", g, sources);
+	return 0;
+}
+
+int main(int argn, char** argv) {
+	AixLog::Log::init<AixLog::SinkCerr>(AixLog::Severity::trace);
+	if (argn < 2) {
+		LOG(INFO) << "Usage: benchmark [MODE] [OPTIONS]\n";
+		LOG(INFO) << "See README.md for more details\n";
+		return 1;
+	}
+	std::string mode(argv[1]);
+	if (mode == "queue") {
+		return run_queue_benchmark(argn, argv);
+	} else if (mode == "engines") {
+		return run_engine_benchmark(argn, argv);
+	} else if (mode == "contraction") {
+		return run_contraction_benchmark(argn, argv);
+	} else if (mode == "cch") {
+		return run_cch_benchmark(argn, argv);
+	}
+	LOG(ERROR) << "Unknown mode: " << mode << "\n";
+	return 1;
+}
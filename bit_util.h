@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Index of the highest set bit. x must not be 0.
+inline uint32_t highest_set_bit(uint32_t x) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse(&index, x);
+	return index;
+#else
+	return 31 - __builtin_clz(x);
+#endif
+}
+
+// Index of the lowest set bit. x must not be 0.
+inline uint32_t lowest_set_bit(uint64_t x) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, x);
+	return index;
+#else
+	return __builtin_ctzll(x);
+#endif
+}
@@ -0,0 +1,364 @@
+#pragma once
+
+#include "graph.h"
+#include "static_graph.h"
+#include "contraction.h"
+#include "nested_dissection.h"
+#include "vector_io.h"
+#include "constants.h"
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <ctype.h>
+#include <aixlog.hpp>
+
+// Customizable contraction hierarchy (Dibbelt, Strasser, Wagner) for a fixed node order. The
+// topology only depends on the order: contracting the nodes in rank order without witness searches
+// gives a chordal supergraph of the input. The order must not depend on the metric, the order of a
+// CH built with witness searches gives a huge fill-in; by default a nested dissection order is
+// computed (see nested_dissection.h). The metric is then computed by customization. Every
+// arc (a, b) with rank a < b has an up weight (a -> b) and a down weight (b -> a), which are the
+// minimum of the input weight and all lower triangles {v, a, b} with rank v < rank a.
+// CCHTopology holds everything that does not depend on penalized weights: the topology, the
+// mapping of input arcs and the metric of the input weights. It is built once and shared by the
+// CustomizableCH of every worker, which only stores its own metric.
+struct CCHTopology {
+	// Lower triangles allowed per input arc before the order is refused. Nested dissection orders of
+	// road networks stay far below, the CH order of an 80x80 grid exceeds it tenfold.
+	static const uint64_t max_triangles_per_input_arc = 10000;
+
+	std::vector<uint32_t> ranking;
+	// Upward graph, arcs of each node sorted by rank of their heads. Arc ids are shared with
+	// the forward and backward graph of every CustomizableCH.
+	MappedVector<uint32_t> first_out;
+	MappedVector<node_t> head;
+	std::vector<node_t> tail;
+	// Downward graph: For every node, the lower neighbours and the id of the arc to them,
+	// sorted by rank.
+	std::vector<uint32_t> down_first_out;
+	std::vector<node_t> down_head;
+	std::vector<uint32_t> down_arc;
+	// Input arc id -> CCH arc id, and whether the input arc points upward
+	std::vector<uint32_t> input_to_arc;
+	std::vector<bool> input_is_up;
+	std::vector<uint32_t> base_up_input, base_down_input;
+	MappedVector<uint32_t> base_up, base_down;
+
+	// Id of the arc between a and b (rank a < rank b), found by binary search over the upward arcs of a
+	uint32_t find_arc(node_t a, node_t b) const {
+		const node_t* begin = head.begin() + first_out[a];
+		const node_t* end = head.begin() + first_out[a + 1];
+		const node_t* it = std::lower_bound(begin, end, b, [this](node_t x, node_t y) {
+			return ranking[x] < ranking[y];
+		});
+		if (it == end || *it != b) {
+			return invalid_id;
+		}
+		return it - head.begin();
+	}
+
+	uint32_t n_arcs() const {
+		return head.size();
+	}
+
+	uint64_t triangles = 0; // Lower triangles, i.e. the work of a full customization
+
+	// Throws std::runtime_error if the order has too many lower triangles.
+	CCHTopology(const StaticGraph& g, std::vector<uint32_t> _ranking) : ranking(std::move(_ranking)) {
+		build_topology(g);
+		build_input_mapping(g);
+		customize();
+		LOG(INFO) << "CCH has " << head.size() << " arcs and " << triangles << " lower triangles\n";
+	}
+
+	// With a nested dissection order of g
+	CCHTopology(const StaticGraph& g) : CCHTopology(g, compute_nested_dissection_ranking(g)) {}
+
+private:
+	void build_topology(const StaticGraph& g) {
+		std::vector<std::vector<node_t>> upper(g.size());
+		for (node_t u = 0; u < g.size(); u++) {
+			for (const Edge& e : g.get_out_arcs(u)) {
+				if (e.target == u) {
+					continue;
+				}
+				if (ranking[u] < ranking[e.target]) {
+					upper[u].push_back(e.target);
+				} else {
+					upper[e.target].push_back(u);
+				}
+			}
+		}
+		// Contract in rank order. The upper neighbours of a node form a clique, it suffices to
+		// add them to the lowest one, which is contracted next among them. Stops as soon as the
+		// number of lower triangles exceeds the limit, the fill-in only grows from there.
+		uint64_t max_triangles = max_triangles_per_input_arc * std::max<uint64_t>(1, g.n_edges());
+		std::vector<node_t> order(g.size());
+		for (node_t n = 0; n < g.size(); n++) {
+			order[ranking[n]] = n;
+		}
+		auto by_rank = [this](node_t x, node_t y) { return ranking[x] < ranking[y]; };
+		for (node_t v : order) {
+			std::vector<node_t>& neighbours = upper[v];
+			std::sort(neighbours.begin(), neighbours.end(), by_rank);
+			neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+			if (neighbours.size() > 1) {
+				triangles += (uint64_t)neighbours.size() * (neighbours.size() - 1) / 2;
+				if (triangles > max_triangles) {
+					throw std::runtime_error("The node order gives a CCH with more than " + std::to_string(max_triangles) + " lower triangles, it is probably not metric-independent");
+				}
+				std::vector<node_t>& parent = upper[neighbours[0]];
+				parent.insert(parent.end(), neighbours.begin() + 1, neighbours.end());
+			}
+		}
+		std::vector<uint32_t> _first_out(g.size() + 1, 0);
+		std::vector<node_t> _head;
+		for (node_t n = 0; n < g.size(); n++) {
+			_first_out[n + 1] = _first_out[n] + upper[n].size();
+			_head.insert(_head.end(), upper[n].begin(), upper[n].end());
+			tail.insert(tail.end(), upper[n].size(), n);
+			std::vector<node_t>().swap(upper[n]);
+		}
+		first_out = share_vector(std::move(_first_out));
+		head = share_vector(std::move(_head));
+		// Downward arcs, sorted by rank because tails are visited in rank order
+		down_first_out = std::vector<uint32_t>(g.size() + 1, 0);
+		down_head = std::vector<node_t>(head.size());
+		down_arc = std::vector<uint32_t>(head.size());
+		for (node_t h : head) {
+			down_first_out[h + 1]++;
+		}
+		for (node_t n = 0; n < g.size(); n++) {
+			down_first_out[n + 1] += down_first_out[n];
+		}
+		std::vector<uint32_t> insert_pos(down_first_out.begin(), down_first_out.end() - 1);
+		for (node_t v : order) {
+			for (uint32_t a = first_out[v]; a < first_out[v + 1]; a++) {
+				uint32_t pos = insert_pos[head[a]]++;
+				down_head[pos] = v;
+				down_arc[pos] = a;
+			}
+		}
+	}
+
+	void build_input_mapping(const StaticGraph& g) {
+		base_up_input = std::vector<uint32_t>(head.size(), inf_weight);
+		base_down_input = std::vector<uint32_t>(head.size(), inf_weight);
+		input_to_arc = std::vector<uint32_t>(g.n_edges(), invalid_id);
+		input_is_up = std::vector<bool>(g.n_edges(), false);
+		for (node_t u = 0; u < g.size(); u++) {
+			const auto& arcs = g.get_out_arcs(u);
+			for (uint32_t i = 0; i < arcs.size(); i++) {
+				node_t v = arcs[i].target;
+				if (v == u) {
+					continue;
+				}
+				uint32_t input_arc = g.get_out_arc_id(u, i);
+				bool is_up = ranking[u] < ranking[v];
+				uint32_t arc = is_up ? find_arc(u, v) : find_arc(v, u);
+				input_to_arc[input_arc] = arc;
+				input_is_up[input_arc] = is_up;
+				std::vector<uint32_t>& input = is_up ? base_up_input : base_down_input;
+				input[arc] = std::min(input[arc], arcs[i].weight);
+			}
+		}
+	}
+
+	// Basic customization: The upward arcs of x are final once all lower triangles {v, x, y} are
+	// applied, so the nodes x are processed in rank order. The arcs of x are looked up by head in
+	// arc_of, so the work is one step per lower triangle.
+	void customize() {
+		std::vector<uint32_t> up = base_up_input;
+		std::vector<uint32_t> down = base_down_input;
+		std::vector<node_t> order(ranking.size());
+		for (node_t n = 0; n < ranking.size(); n++) {
+			order[ranking[n]] = n;
+		}
+		std::vector<uint32_t> arc_of(ranking.size(), invalid_id);
+		for (node_t x : order) {
+			for (uint32_t xy = first_out[x]; xy < first_out[x + 1]; xy++) {
+				arc_of[head[xy]] = xy;
+			}
+			for (uint32_t i = down_first_out[x]; i < down_first_out[x + 1]; i++) {
+				node_t v = down_head[i];
+				uint32_t vx = down_arc[i];
+				// Upper neighbours of v above x are upper neighbours of x (chordality)
+				for (uint32_t vy = vx + 1; vy < first_out[v + 1]; vy++) {
+					uint32_t xy = arc_of[head[vy]];
+					up[xy] = std::min(up[xy], down[vx] + up[vy]);
+					down[xy] = std::min(down[xy], down[vy] + up[vx]);
+				}
+			}
+		}
+		base_up = share_vector(std::move(up));
+		base_down = share_vector(std::move(down));
+	}
+};
+
+// Metric of one worker on a shared CCHTopology. After input weights change, update only
+// recomputes arcs whose lower triangles changed, in rank order of their tails. reset restores the
+// metric of the topology for the changed arcs only. get_ch exposes the metric as a
+// ContractionHierarchy whose weights are patched in place; its weight arrays are shared with the
+// topology until the first change.
+class CustomizableCH {
+
+	private:
+		const CCHTopology& topology;
+		ContractionHierarchy ch;
+		std::unordered_map<uint32_t, std::pair<uint32_t, uint32_t>> changed_inputs; // Arc -> up and down input
+		std::vector<bool> is_modified;
+		std::vector<uint32_t> modified_arcs; // Arcs whose input or metric differs from the base
+		std::vector<uint32_t> updated_arcs; // Arcs whose metric changed in the last update or reset
+		std::priority_queue<std::pair<uint32_t, uint32_t>, std::vector<std::pair<uint32_t, uint32_t>>, std::greater<std::pair<uint32_t, uint32_t>>> queue; // (rank of tail, arc)
+		std::vector<bool> is_queued;
+
+		void push(uint32_t arc) {
+			if (!is_queued[arc]) {
+				is_queued[arc] = true;
+				queue.push(std::make_pair(topology.ranking[topology.tail[arc]], arc));
+			}
+		}
+
+		uint32_t up(uint32_t arc) const {
+			return ch.forward_graph.get_arc_weight(arc);
+		}
+
+		uint32_t down(uint32_t arc) const {
+			return ch.backward_graph.get_arc_weight(arc);
+		}
+
+		void set_metric(uint32_t arc, uint32_t new_up, uint32_t new_down) {
+			ch.forward_graph.set_arc_weight(arc, new_up);
+			ch.backward_graph.set_arc_weight(arc, new_down);
+			updated_arcs.push_back(arc);
+		}
+
+		void mark_modified(uint32_t arc) {
+			if (!is_modified[arc]) {
+				is_modified[arc] = true;
+				modified_arcs.push_back(arc);
+			}
+		}
+
+	public:
+		CustomizableCH(const CCHTopology& topology) :
+			topology(topology),
+			is_modified(topology.n_arcs(), false),
+			is_queued(topology.n_arcs(), false)
+		{
+			ch.forward_graph = StaticGraph(topology.first_out, topology.head, topology.base_up, false);
+			ch.backward_graph = StaticGraph(topology.first_out, topology.head, topology.base_down, false);
+			ch.ranking = topology.ranking;
+		}
+
+		// Metric is patched by update and reset, the topology never changes.
+		const ContractionHierarchy& get_ch() const {
+			return ch;
+		}
+
+		// Changes the weight of an arc of the input graph. Takes effect on the next update.
+		void set_input_weight(uint32_t input_arc, uint32_t weight) {
+			uint32_t arc = topology.input_to_arc[input_arc];
+			if (arc == invalid_id) {
+				return;
+			}
+			auto& input = changed_inputs.try_emplace(arc, topology.base_up_input[arc], topology.base_down_input[arc]).first->second;
+			if (topology.input_is_up[input_arc]) {
+				input.first = weight;
+			} else {
+				input.second = weight;
+			}
+			mark_modified(arc);
+			push(arc);
+		}
+
+		// Partial customization: Recomputes all arcs with changed inputs and, if their metric changed,
+		// all arcs that have them in a lower triangle.
+		void update() {
+			const CCHTopology& t = topology;
+			updated_arcs.clear();
+			while (!queue.empty()) {
+				uint32_t arc = queue.top().second;
+				queue.pop();
+				is_queued[arc] = false;
+				node_t a = t.tail[arc];
+				node_t b = t.head[arc];
+				auto input = changed_inputs.find(arc);
+				uint32_t new_up = input != changed_inputs.end() ? input->second.first : t.base_up_input[arc];
+				uint32_t new_down = input != changed_inputs.end() ? input->second.second : t.base_down_input[arc];
+				// Lower triangles: common lower neighbours of a and b
+				uint32_t i = t.down_first_out[a];
+				uint32_t j = t.down_first_out[b];
+				while (i < t.down_first_out[a + 1] && j < t.down_first_out[b + 1]) {
+					if (t.down_head[i] == t.down_head[j]) {
+						uint32_t va = t.down_arc[i];
+						uint32_t vb = t.down_arc[j];
+						new_up = std::min(new_up, down(va) + up(vb));
+						new_down = std::min(new_down, down(vb) + up(va));
+						i++;
+						j++;
+					} else if (t.ranking[t.down_head[i]] < t.ranking[t.down_head[j]]) {
+						i++;
+					} else {
+						j++;
+					}
+				}
+				if (new_up == up(arc) && new_down == down(arc)) {
+					continue;
+				}
+				set_metric(arc, new_up, new_down);
+				mark_modified(arc);
+				// Triangles {a, b, y} with a as lowest node, the arc between b and y is on top
+				for (uint32_t ay = t.first_out[a]; ay < t.first_out[a + 1]; ay++) {
+					node_t y = t.head[ay];
+					if (y == b) {
+						continue;
+					}
+					push(t.ranking[b] < t.ranking[y] ? t.find_arc(b, y) : t.find_arc(y, b));
+				}
+			}
+		}
+
+		// Restores inputs and metric of the topology.
+		void reset() {
+			updated_arcs.clear();
+			while (!queue.empty()) {
+				is_queued[queue.top().second] = false;
+				queue.pop();
+			}
+			changed_inputs.clear();
+			for (uint32_t arc : modified_arcs) {
+				if (up(arc) != topology.base_up[arc] || down(arc) != topology.base_down[arc]) {
+					set_metric(arc, topology.base_up[arc], topology.base_down[arc]);
+				}
+				is_modified[arc] = false;
+			}
+			modified_arcs.clear();
+		}
+
+		// Arcs whose metric changed in the last update or reset
+		const std::vector<uint32_t>& get_updated_arcs() const {
+			return updated_arcs;
+		}
+
+		node_t get_tail(uint32_t arc) const {
+			return topology.tail[arc];
+		}
+
+		// Index of the arc among the upward arcs of its tail
+		uint32_t get_local_index(uint32_t arc) const {
+			return arc - topology.first_out[topology.tail[arc]];
+		}
+
+		uint32_t get_up_weight(uint32_t arc) const {
+			return up(arc);
+		}
+
+		uint32_t get_down_weight(uint32_t arc) const {
+			return down(arc);
+		}
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+
+// Marks a missing node or edge id.
+const uint32_t invalid_id = 4294967295u;
+
+// Distance of unreachable nodes. Chosen such that inf_weight + inf_weight does not overflow.
+const uint32_t inf_weight = 2147483647u;
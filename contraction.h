@@ -1,63 +1,282 @@
 #pragma once
 
 #include "graph.h"
+#include "static_graph.h"
 #include "dijkstra.h"
+#include "id_queue.h"
+#include "timestamp_vector.h"
 #include "progressbar.h"
 #include "timer.h"
-#include "bucket_queue.h"
 #include "boolset.h"
 #include "util.h"
+#include "work_stealing_queue.h"
 #include <utility>
+#include <unordered_map>
+#include <algorithm>
 #include <ctype.h>
+#include <thread>
 #include <aixlog.hpp>
 
 std::vector<std::pair<node_t, Edge>> shortcut_list(1000);
 
+// The hierarchy is only read after contraction, so both halves are stored as StaticGraph.
+// forward_middle and backward_middle hold the middle node of every arc of the halves, indexed by
+// arc id, or invalid_id for input arcs. They are empty if the middle nodes are not known (e.g. a
+// RoutingKit CH).
 struct ContractionHierarchy {
-	Graph forward_graph;
-	Graph backward_graph;
+	StaticGraph forward_graph;
+	StaticGraph backward_graph;
 	std::vector<node_t> ranking;
+	std::vector<node_t> forward_middle;
+	std::vector<node_t> backward_middle;
+
+	bool has_middle_nodes() const {
+		return forward_middle.size() == forward_graph.n_edges() && backward_middle.size() == backward_graph.n_edges();
+	}
 };
 
-const std::vector<std::pair<node_t, Edge>>& get_contraction_shortcuts(const Graph& g, node_t node, DijkstraService& dijkstra_service) {
-	shortcut_list.clear();
-	const std::vector<Edge>& out_arcs = g.get_out_arcs(node);
-	const std::vector<Edge>& rev_out_arcs = g.get_rev_out_arcs(node);
-	for (int i = 0; i < rev_out_arcs.size(); i++) {
-		dijkstra_service.set_blacklisted(node);
-		dijkstra_service.set_source(rev_out_arcs[i].target);
-		for (int j = 0; j < out_arcs.size(); j++) {
-			dijkstra_service.set_max_dist(rev_out_arcs[i].weight + out_arcs[j].weight);
-			dijkstra_service.run_until_target_found(out_arcs[j].target);
-			if (dijkstra_service.get_dist(out_arcs[j].target) > rev_out_arcs[i].weight + out_arcs[j].weight) {
-				node_t start = rev_out_arcs[i].target;
-				Edge edge = { out_arcs[j].target, rev_out_arcs[i].weight + out_arcs[j].weight };
-				shortcut_list.push_back(std::make_pair(start, edge));
+uint64_t arc_key(node_t u, node_t v) {
+	return ((uint64_t)u << 32) | v;
+}
+
+// Builds the hierarchy from a graph with all input arcs and shortcuts. middle holds the middle node
+// of every arc of ch_graph (invalid_id for input arcs) or is empty.
+ContractionHierarchy build_ch(const StaticGraph& ch_graph, const std::vector<uint32_t>& ranking, const std::vector<node_t>& middle) {
+	auto split = split_graph(ch_graph, ranking);
+	ContractionHierarchy ch = { std::move(split.first), std::move(split.second), ranking, {}, {} };
+	if (middle.empty()) {
+		return ch;
+	}
+	// The split removes parallel arcs, so the arcs are looked up again
+	ch.forward_middle.assign(ch.forward_graph.n_edges(), invalid_id);
+	ch.backward_middle.assign(ch.backward_graph.n_edges(), invalid_id);
+	for (node_t n = 0; n < ch_graph.size(); n++) {
+		uint32_t i = ch_graph.get_out_arc_id(n, 0);
+		for (const Edge& e : ch_graph.get_out_arcs(n)) {
+			if (ranking[n] < ranking[e.target]) {
+				uint32_t arc = ch.forward_graph.find_arc(n, e.target);
+				if (ch.forward_graph.get_arc_weight(arc) == e.weight) {
+					ch.forward_middle[arc] = middle[i];
+				}
+			} else {
+				uint32_t arc = ch.backward_graph.find_arc(e.target, n);
+				if (ch.backward_graph.get_arc_weight(arc) == e.weight) {
+					ch.backward_middle[arc] = middle[i];
+				}
 			}
+			i++;
 		}
-		dijkstra_service.finish();
 	}
-	return shortcut_list;
+	return ch;
 }
 
-BucketQueue get_initial_queue(const Graph& g) {
-	int min_diff = INT_MAX;
-	std::vector<uint32_t> edge_diff_vec(g.size());
-	BucketQueue queue(g.size());
-	ProgressBar progress_bar;
-	DijkstraService dijkstra_service(g);
-	for (node_t n = 0; n < g.size(); n++) {
-		const auto& shortcuts = get_contraction_shortcuts(g, n, dijkstra_service);
-		int edge_diff = shortcuts.size() - g.get_out_arcs(n).size() - g.get_rev_out_arcs(n).size();
-		queue.push({ n, edge_diff });
-		progress_bar.update_progress((double)n / g.size());
+// middle_nodes maps the arc key of every shortcut in ch_graph to its middle node.
+ContractionHierarchy build_ch(const Graph& ch_graph, const std::vector<uint32_t>& ranking, const std::unordered_map<uint64_t, node_t>& middle_nodes) {
+	StaticGraph static_graph(ch_graph, false);
+	std::vector<node_t> middle;
+	middle.reserve(static_graph.n_edges());
+	for (node_t n = 0; n < static_graph.size(); n++) {
+		for (const Edge& e : static_graph.get_out_arcs(n)) {
+			auto it = middle_nodes.find(arc_key(n, e.target));
+			middle.push_back(it == middle_nodes.end() ? invalid_id : it->second);
+		}
 	}
-	progress_bar.finish();
-	return queue;
+	return build_ch(static_graph, ranking, middle);
 }
 
-const std::vector<std::pair<node_t, Edge>>& contract_node(Graph& g, node_t node, DijkstraService& dijkstra_service) {
-	const auto& shortcuts = get_contraction_shortcuts(g, node, dijkstra_service);
+// Limits of the witness searches. A search that stops early may miss a witness, which only adds
+// a shortcut that is not needed. Unlimited by default.
+struct WitnessLimits {
+	uint32_t max_hops = inf_weight; // Arcs of a witness path
+	uint32_t max_settled = inf_weight; // Settled nodes per search
+};
+
+struct WitnessStats {
+	uint64_t searches = 0;
+	uint64_t settled_nodes = 0;
+	uint64_t settle_limit_hits = 0; // Searches stopped by max_settled
+	uint64_t hop_limit_hits = 0; // Nodes whose arcs were not relaxed because of max_hops
+
+	void add(const WitnessStats& other) {
+		searches += other.searches;
+		settled_nodes += other.settled_nodes;
+		settle_limit_hits += other.settle_limit_hits;
+		hop_limit_hits += other.hop_limit_hits;
+	}
+};
+
+// Finds the shortcuts needed to contract a node. There is one search per in-neighbour x, which
+// looks for witnesses to all out-neighbours at once. It stops when all of them are settled, when
+// the key exceeds the longest path via the contracted node, or at a limit. A target that was
+// reached but not settled has a path of its tentative distance, which is a witness as well.
+// Only reads the graph, so several threads can search the same graph with their own instance.
+class WitnessSearch {
+
+private:
+	const Graph& g;
+	WitnessLimits limits;
+	MinIDQueue queue;
+	TimestampVector<uint32_t> dist;
+	TimestampVector<uint32_t> hops;
+	TimestampVector<uint32_t> is_target;
+	const std::vector<bool>* blacklist = NULL;
+	WitnessStats stats;
+
+	void run(node_t source, node_t skipped, uint32_t max_dist, uint32_t target_count) {
+		stats.searches++;
+		dist.set(source, 0);
+		hops.set(source, 0);
+		queue.push({ source, 0 });
+		count_push(StatsScope::WITNESS);
+		uint32_t settled = 0;
+		while (!queue.empty() && target_count > 0) {
+			IDKeyPair best = queue.pop();
+			if (best.key > max_dist) {
+				break;
+			}
+			count_settled(StatsScope::WITNESS);
+			stats.settled_nodes++;
+			if (is_target.get(best.id)) {
+				target_count--;
+			}
+			if (++settled >= limits.max_settled) {
+				stats.settle_limit_hits++;
+				break;
+			}
+			uint32_t best_hops = hops.get(best.id);
+			if (best_hops >= limits.max_hops) {
+				stats.hop_limit_hits++;
+				continue;
+			}
+			const auto& arcs = g.get_out_arcs(best.id);
+			count_relaxed(StatsScope::WITNESS, arcs.size());
+			for (const Edge& e : arcs) {
+				if (e.target == skipped || (blacklist != NULL && (*blacklist)[e.target])) {
+					continue;
+				}
+				uint32_t d = best.key + e.weight;
+				if (d < dist.get(e.target)) {
+					dist.set(e.target, d);
+					hops.set(e.target, best_hops + 1);
+					if (queue.contains_id(e.target)) {
+						queue.decrease_key({ e.target, d });
+						count_decrease_key(StatsScope::WITNESS);
+					} else {
+						queue.push({ e.target, d });
+						count_push(StatsScope::WITNESS);
+					}
+				}
+			}
+		}
+		queue.clear();
+	}
+
+public:
+	WitnessSearch(const Graph& g, WitnessLimits limits = WitnessLimits()) :
+		g(g), limits(limits), queue(g.size()), dist(g.size(), inf_weight), hops(g.size(), 0), is_target(g.size(), 0) {}
+
+	// Nodes n with (*blacklist)[n] are not used by witnesses, until it is set to NULL again.
+	void set_blacklist(const std::vector<bool>* blacklist) {
+		this->blacklist = blacklist;
+	}
+
+	const WitnessStats& get_stats() const {
+		return stats;
+	}
+
+	// Appends the shortcuts needed to contract node.
+	void find_shortcuts(node_t node, std::vector<std::pair<node_t, Edge>>& shortcuts) {
+		const std::vector<Edge>& out_arcs = g.get_out_arcs(node);
+		const std::vector<Edge>& in_arcs = g.get_rev_out_arcs(node);
+		for (const Edge& in : in_arcs) {
+			node_t x = in.target;
+			uint32_t max_dist = 0;
+			uint32_t target_count = 0;
+			for (const Edge& out : out_arcs) {
+				if (out.target != x) {
+					is_target.set(out.target, 1);
+					target_count++;
+					max_dist = std::max(max_dist, in.weight + out.weight);
+				}
+			}
+			if (target_count > 0) {
+				run(x, node, max_dist, target_count);
+				for (const Edge& out : out_arcs) {
+					if (out.target != x && dist.get(out.target) > in.weight + out.weight) {
+						shortcuts.push_back(std::make_pair(x, Edge{ out.target, in.weight + out.weight }));
+					}
+				}
+			}
+			dist.step_time();
+			hops.step_time();
+			is_target.step_time();
+		}
+	}
+};
+
+const std::vector<std::pair<node_t, Edge>>& get_contraction_shortcuts(node_t node, WitnessSearch& witness_search) {
+	shortcut_list.clear();
+	witness_search.find_shortcuts(node, shortcut_list);
+	return shortcut_list;
+}
+
+// Contraction priority of a node, smaller is contracted first. Combines the edge difference
+// (shortcuts added minus arcs removed), the difference of input arcs represented by these arcs
+// (shortcuts over long paths are expensive to unpack and search) and the number of contracted
+// neighbours, which spreads the contraction evenly over the graph.
+class ContractionPriority {
+
+private:
+	const Graph& g;
+	std::vector<uint32_t> deleted_neighbours;
+	std::unordered_map<uint64_t, uint32_t> original_arcs; // Only arcs that represent more than one input arc
+
+	uint32_t get_original_arcs(node_t u, node_t v) const {
+		auto it = original_arcs.find(arc_key(u, v));
+		return it == original_arcs.end() ? 1 : it->second;
+	}
+
+public:
+	ContractionPriority(const Graph& g) : g(g), deleted_neighbours(g.size(), 0) {}
+
+	// shortcuts are the shortcuts needed to contract node in the current graph. May be called
+	// by several threads at once, but not concurrently with contract.
+	int get(node_t node, const std::vector<std::pair<node_t, Edge>>& shortcuts) const {
+		int removed_original = 0;
+		for (const Edge& e : g.get_out_arcs(node)) {
+			removed_original += get_original_arcs(node, e.target);
+		}
+		for (const Edge& e : g.get_rev_out_arcs(node)) {
+			removed_original += get_original_arcs(e.target, node);
+		}
+		int added_original = 0;
+		for (const auto& shortcut : shortcuts) {
+			added_original += get_original_arcs(shortcut.first, node) + get_original_arcs(node, shortcut.second.target);
+		}
+		int edge_difference = (int)shortcuts.size() - (int)g.get_out_arcs(node).size() - (int)g.get_rev_out_arcs(node).size();
+		return 2 * edge_difference + (added_original - removed_original) + (int)deleted_neighbours[node];
+	}
+
+	// Must be called right before the shortcuts of node are inserted and node is disconnected.
+	void contract(node_t node, const std::vector<std::pair<node_t, Edge>>& shortcuts) {
+		for (const Edge& e : g.get_out_arcs(node)) {
+			deleted_neighbours[e.target]++;
+		}
+		for (const Edge& e : g.get_rev_out_arcs(node)) {
+			deleted_neighbours[e.target]++;
+		}
+		for (const auto& shortcut : shortcuts) {
+			node_t x = shortcut.first;
+			node_t y = shortcut.second.target;
+			if (shortcut.second.weight < g.get_edge_weight(x, y)) {
+				original_arcs[arc_key(x, y)] = get_original_arcs(x, node) + get_original_arcs(node, y);
+			}
+		}
+	}
+};
+
+const std::vector<std::pair<node_t, Edge>>& contract_node(Graph& g, node_t node, WitnessSearch& witness_search) {
+	const auto& shortcuts = get_contraction_shortcuts(node, witness_search);
 	for (int i = 0; i < shortcuts.size(); i++) {
 		g.add_edge(shortcuts[i].first, shortcuts[i].second);
 	}
@@ -65,105 +284,398 @@ const std::vector<std::pair<node_t, Edge>>& contract_node(Graph& g, node_t node,
 	return shortcuts;
 }
 
-void contract_node_and_split(Graph& g, node_t node, Graph& forward_graph, Graph& backward_graph, const std::vector<uint32_t>& ranking, DijkstraService& dijkstra_service) {
-	const auto& shortcuts = get_contraction_shortcuts(g, node, dijkstra_service);
-	for (int i = 0; i < shortcuts.size(); i++) {
-		g.add_edge(shortcuts[i].first, shortcuts[i].second);
-		if (ranking[shortcuts[i].first] < ranking[shortcuts[i].second.target]) {
-			forward_graph.add_edge(shortcuts[i].first, shortcuts[i].second);
+// Finds the middle nodes of a CH without them (e.g. from RoutingKit). Arcs with the weight of the
+// input arc are input arcs. Every other arc u->v was added when some node m below u and v was
+// contracted, so the arcs u->m and m->v sum up to its weight; these triangles are enumerated from
+// m, the lowest node. Throws if an arc has no such triangle.
+void compute_middle_nodes(ContractionHierarchy& ch, const StaticGraph& g) {
+	const node_t missing = invalid_id - 1;
+	ch.forward_middle.assign(ch.forward_graph.n_edges(), invalid_id);
+	ch.backward_middle.assign(ch.backward_graph.n_edges(), invalid_id);
+	for (node_t n = 0; n < g.size(); n++) {
+		uint32_t arc = ch.forward_graph.get_out_arc_id(n, 0);
+		for (const Edge& e : ch.forward_graph.get_out_arcs(n)) {
+			if (e.weight != g.get_edge_weight(n, e.target)) {
+				ch.forward_middle[arc] = missing;
+			}
+			arc++;
 		}
-		else {
-			backward_graph.add_edge(shortcuts[i].second.target, { shortcuts[i].first, shortcuts[i].second.weight });
+		arc = ch.backward_graph.get_out_arc_id(n, 0);
+		for (const Edge& e : ch.backward_graph.get_out_arcs(n)) {
+			if (e.weight != g.get_edge_weight(e.target, n)) {
+				ch.backward_middle[arc] = missing;
+			}
+			arc++;
 		}
 	}
-	g.disconnect_node(node);
+	for (node_t m = 0; m < g.size(); m++) {
+		for (const Edge& in : ch.backward_graph.get_out_arcs(m)) {
+			for (const Edge& out : ch.forward_graph.get_out_arcs(m)) {
+				node_t u = in.target;
+				node_t v = out.target;
+				if (u == v) {
+					continue;
+				}
+				bool is_up = ch.ranking[u] < ch.ranking[v];
+				uint32_t arc = is_up ? ch.forward_graph.find_arc(u, v) : ch.backward_graph.find_arc(v, u);
+				if (arc == invalid_id) {
+					continue;
+				}
+				node_t& middle = is_up ? ch.forward_middle[arc] : ch.backward_middle[arc];
+				uint32_t weight = is_up ? ch.forward_graph.get_arc_weight(arc) : ch.backward_graph.get_arc_weight(arc);
+				if (middle == missing && weight == in.weight + out.weight) {
+					middle = m;
+				}
+			}
+		}
+	}
+	if (std::find(ch.forward_middle.begin(), ch.forward_middle.end(), missing) != ch.forward_middle.end()
+		|| std::find(ch.backward_middle.begin(), ch.backward_middle.end(), missing) != ch.backward_middle.end()) {
+		throw std::runtime_error("CH has arcs that are neither input arcs nor shortcuts");
+	}
 }
 
+// Sets node as middle node of the shortcuts that replace an arc or add a new one. Must be called
+// before the shortcuts are inserted into g.
+void record_middle_nodes(const Graph& g, node_t node, const std::vector<std::pair<node_t, Edge>>& shortcuts, std::unordered_map<uint64_t, node_t>& middle_nodes) {
+	for (const auto& shortcut : shortcuts) {
+		if (shortcut.second.weight < g.get_edge_weight(shortcut.first, shortcut.second.target)) {
+			middle_nodes[arc_key(shortcut.first, shortcut.second.target)] = node;
+		}
+	}
+}
+
+// Contracts g in the given order, g is left without arcs.
 ContractionHierarchy contract_graph(Graph& g, const std::vector<node_t>& order) {
 	ProgressBar progress_bar;
-	DijkstraService dijkstra_service(g);
+	WitnessSearch witness_search(g);
 	std::vector<uint32_t> ranking = order_to_ranking(order);
-	auto g_split = split_graph(g, ranking);
+	Graph ch_graph(g);
+	std::unordered_map<uint64_t, node_t> middle_nodes;
 	for (uint32_t i = 0; i < order.size(); i++) {
-		contract_node_and_split(g, order[i], g_split.first, g_split.second, ranking, dijkstra_service);
+		const auto& shortcuts = get_contraction_shortcuts(order[i], witness_search);
+		record_middle_nodes(g, order[i], shortcuts, middle_nodes);
+		for (const auto& shortcut : shortcuts) {
+			g.add_edge(shortcut.first, shortcut.second);
+			ch_graph.add_edge(shortcut.first, shortcut.second);
+		}
+		g.disconnect_node(order[i]);
 		progress_bar.update_progress((double)i / order.size());
 	}
 	progress_bar.finish();
-	return  { g_split.first, g_split.second, ranking };
+	return build_ch(ch_graph, ranking, middle_nodes);
 }
 
-ContractionHierarchy contract_by_queue(Graph& _g) {
-	Graph g(_g);
+// Contracts the node with the smallest priority next. Priorities are updated for the neighbours
+// of every contracted node and lazily on pop: If the recomputed priority of the top node is larger
+// than the next key, it is pushed back instead.
+ContractionHierarchy contract_by_queue(const Graph& input) {
+	Graph g(input); // Remaining graph, contracted nodes are disconnected
+	Graph ch_graph(input); // Input arcs and all shortcuts
+	WitnessSearch witness_search(g);
+	ContractionPriority priority(g);
+	KaryIDQueue<4, int> queue(g.size());
+	std::vector<std::pair<node_t, Edge>> shortcuts;
+	std::unordered_map<uint64_t, node_t> middle_nodes;
 	LOG(INFO) << "Calculating initial queue...\n";
-	BucketQueue queue = get_initial_queue(g);
-	int min_key = -(int)(queue.peek().key);
-	if (min_key < 0) { min_key = 0; }
-	LOG(INFO) << "Contracting Graph...\n";
-	DijkstraService dijkstra_service(g);
 	ProgressBar progress_bar;
-	std::vector<node_t> neighbour_list(1000); // Preallocate for performance
+	for (node_t n = 0; n < g.size(); n++) {
+		shortcuts.clear();
+		witness_search.find_shortcuts(n, shortcuts);
+		queue.push({ n, priority.get(n, shortcuts) });
+		progress_bar.update_progress((double)n / g.size());
+	}
+	progress_bar.finish();
+	LOG(INFO) << "Contracting Graph...\n";
+	std::vector<node_t> neighbours;
 	std::vector<uint32_t> ranking(g.size());
-	int cur_rank = 0;
+	uint32_t cur_rank = 0;
+	uint32_t lazy_updates = 0;
 	while (!queue.empty()) {
-		neighbour_list.clear();
-		node_t best = queue.pop().id;
-		ranking[best] = cur_rank;
-		cur_rank++;
-		const std::vector<Edge>& out_arcs = g.get_out_arcs(best);
-		const std::vector<Edge>& rev_out_arcs = g.get_rev_out_arcs(best);
-		for (int i = 0; i < out_arcs.size(); i++) { neighbour_list.push_back(out_arcs[i].target); }
-		for (int i = 0; i < rev_out_arcs.size(); i++) { neighbour_list.push_back(rev_out_arcs[i].target); }
-		const auto& shortcuts = contract_node(g, best, dijkstra_service);
-		for (int i = 0; i < shortcuts.size(); i++) {
-			_g.add_edge(shortcuts[i].first, shortcuts[i].second);
-		}
-		for (int i = 0; i < neighbour_list.size(); i++) {
-			node_t neighbour = neighbour_list[i];
-			if (queue.contains_id(neighbour)) {
-				get_contraction_shortcuts(g, neighbour, dijkstra_service);
-				int old_key = queue.get_key(neighbour);
-				int new_key = shortcuts.size() - g.get_out_arcs(neighbour).size() - g.get_rev_out_arcs(neighbour).size() + 1;
-				if (old_key != new_key) {
-					queue.change_key({ neighbour, new_key });
-				}
+		node_t best = queue.peek().id;
+		shortcuts.clear();
+		witness_search.find_shortcuts(best, shortcuts);
+		int key = priority.get(best, shortcuts);
+		if (key != queue.peek().key) {
+			queue.change_key({ best, key });
+			if (queue.peek().id != best) {
+				lazy_updates++;
+				continue;
 			}
 		}
+		queue.pop();
+		ranking[best] = cur_rank++;
+		neighbours.clear();
+		for (const Edge& e : g.get_out_arcs(best)) {
+			neighbours.push_back(e.target);
+		}
+		for (const Edge& e : g.get_rev_out_arcs(best)) {
+			neighbours.push_back(e.target);
+		}
+		priority.contract(best, shortcuts);
+		record_middle_nodes(g, best, shortcuts, middle_nodes);
+		g.disconnect_node(best);
+		for (const auto& shortcut : shortcuts) {
+			g.add_edge(shortcut.first, shortcut.second);
+			ch_graph.add_edge(shortcut.first, shortcut.second);
+		}
+		std::sort(neighbours.begin(), neighbours.end());
+		neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+		for (node_t neighbour : neighbours) {
+			shortcuts.clear();
+			witness_search.find_shortcuts(neighbour, shortcuts);
+			queue.change_key({ neighbour, priority.get(neighbour, shortcuts) });
+		}
 		progress_bar.update_progress((double)cur_rank / g.size());
 	}
 	progress_bar.finish();
-	auto split = split_graph(g, ranking);
-	return { split.first, split.second, ranking };
+	LOG(INFO) << ch_graph.n_edges() - input.n_edges() << " shortcuts, " << lazy_updates << " lazy updates\n";
+	return build_ch(ch_graph, ranking, middle_nodes);
 }
 
+// Runs f(worker, i) for i in [0, count) on thread_count threads.
+template <class F>
+void parallel_for(uint32_t count, uint32_t thread_count, F f) {
+	if (thread_count == 1 || count < thread_count) {
+		for (uint32_t i = 0; i < count; i++) {
+			f(0, i);
+		}
+		return;
+	}
+	WorkStealingQueue queue(count, thread_count);
+	std::vector<std::thread> threads;
+	for (uint32_t w = 0; w < thread_count; w++) {
+		threads.emplace_back([&queue, &f, w]() {
+			for (uint32_t i = queue.pop(w); i != invalid_id; i = queue.pop(w)) {
+				f(w, i);
+			}
+		});
+	}
+	for (std::thread& t : threads) {
+		t.join();
+	}
+}
+
+// Contracts the graph in rounds. Every round selects the remaining nodes whose priority (see
+// ContractionPriority, ties broken by id) is smaller than that of all remaining neighbours. These nodes are
+// independent, so their shortcuts are computed in parallel on the same graph. The witness searches
+// skip all nodes of the round, so every witness survives the contraction of the others. Shortcuts
+// are then inserted and the priorities of the neighbours recomputed, again in parallel.
+// limits bound the witness searches, both for priorities and contraction.
+ContractionHierarchy contract_parallel(const Graph& input, uint32_t thread_count, WitnessLimits limits = WitnessLimits()) {
+	Graph g(input); // Remaining graph, contracted nodes are disconnected
+	Graph ch_graph(input); // Input arcs and all shortcuts
+	uint32_t n = g.size();
+	std::vector<WitnessSearch> witness_searches;
+	witness_searches.reserve(thread_count);
+	for (uint32_t w = 0; w < thread_count; w++) {
+		witness_searches.emplace_back(g, limits);
+	}
+	std::vector<std::vector<std::pair<node_t, Edge>>> shortcuts(n);
+	ContractionPriority contraction_priority(g);
+	std::unordered_map<uint64_t, node_t> middle_nodes;
+	auto get_priority = [&](uint32_t worker, node_t v) {
+		shortcuts[v].clear();
+		witness_searches[worker].find_shortcuts(v, shortcuts[v]);
+		int priority = contraction_priority.get(v, shortcuts[v]);
+		shortcuts[v].clear();
+		return priority;
+	};
+	LOG(INFO) << "Calculating initial priorities...\n";
+	std::vector<int> priority(n);
+	parallel_for(n, thread_count, [&](uint32_t worker, uint32_t v) {
+		priority[v] = get_priority(worker, v);
+	});
+	LOG(INFO) << "Contracting Graph on " << thread_count << " threads...\n";
+	auto is_before = [&priority](node_t a, node_t b) {
+		return priority[a] < priority[b] || (priority[a] == priority[b] && a < b);
+	};
+	std::vector<uint32_t> ranking(n, invalid_id);
+	std::vector<node_t> remaining(n);
+	for (node_t v = 0; v < n; v++) {
+		remaining[v] = v;
+	}
+	std::vector<bool> in_round(n, false);
+	std::vector<bool> needs_update(n, false);
+	std::vector<node_t> round_nodes, neighbours;
+	uint32_t cur_rank = 0;
+	uint32_t rounds = 0;
+	ProgressBar progress_bar;
+	while (!remaining.empty()) {
+		// Select independent set
+		round_nodes.clear();
+		for (node_t v : remaining) {
+			bool is_minimal = true;
+			for (const Edge& e : g.get_out_arcs(v)) {
+				is_minimal &= !is_before(e.target, v);
+			}
+			for (const Edge& e : g.get_rev_out_arcs(v)) {
+				is_minimal &= !is_before(e.target, v);
+			}
+			if (is_minimal) {
+				round_nodes.push_back(v);
+				in_round[v] = true;
+			}
+		}
+		// Simulate contractions in parallel
+		for (WitnessSearch& witness_search : witness_searches) {
+			witness_search.set_blacklist(&in_round);
+		}
+		parallel_for(round_nodes.size(), thread_count, [&](uint32_t worker, uint32_t i) {
+			witness_searches[worker].find_shortcuts(round_nodes[i], shortcuts[round_nodes[i]]);
+		});
+		for (WitnessSearch& witness_search : witness_searches) {
+			witness_search.set_blacklist(NULL);
+		}
+		// Insert shortcuts
+		neighbours.clear();
+		for (node_t v : round_nodes) {
+			ranking[v] = cur_rank++;
+			for (const Edge& e : g.get_out_arcs(v)) {
+				if (!needs_update[e.target] && !in_round[e.target]) {
+					needs_update[e.target] = true;
+					neighbours.push_back(e.target);
+				}
+			}
+			for (const Edge& e : g.get_rev_out_arcs(v)) {
+				if (!needs_update[e.target] && !in_round[e.target]) {
+					needs_update[e.target] = true;
+					neighbours.push_back(e.target);
+				}
+			}
+			contraction_priority.contract(v, shortcuts[v]);
+			record_middle_nodes(g, v, shortcuts[v], middle_nodes);
+			g.disconnect_node(v);
+			for (const auto& shortcut : shortcuts[v]) {
+				g.add_edge(shortcut.first, shortcut.second);
+				ch_graph.add_edge(shortcut.first, shortcut.second);
+			}
+			std::vector<std::pair<node_t, Edge>>().swap(shortcuts[v]);
+		}
+		for (node_t v : round_nodes) {
+			in_round[v] = false;
+		}
+		// Update priorities of the neighbours
+		parallel_for(neighbours.size(), thread_count, [&](uint32_t worker, uint32_t i) {
+			priority[neighbours[i]] = get_priority(worker, neighbours[i]);
+		});
+		for (node_t v : neighbours) {
+			needs_update[v] = false;
+		}
+		remaining.erase(std::remove_if(remaining.begin(), remaining.end(), [&ranking](node_t v) {
+			return ranking[v] != invalid_id;
+		}), remaining.end());
+		rounds++;
+		progress_bar.update_progress((double)cur_rank / n);
+	}
+	progress_bar.finish();
+	WitnessStats stats;
+	for (const WitnessSearch& witness_search : witness_searches) {
+		stats.add(witness_search.get_stats());
+	}
+	LOG(INFO) << "Contracted in " << rounds << " rounds, " << ch_graph.n_edges() - input.n_edges() << " shortcuts\n";
+	LOG(INFO) << "Witness searches: " << stats.searches << ", settled nodes: " << stats.settled_nodes
+		<< ", stopped by settle limit: " << stats.settle_limit_hits << ", nodes at hop limit: " << stats.hop_limit_hits << "\n";
+	return build_ch(ch_graph, ranking, middle_nodes);
+}
+
+// Replaces CH arcs by the input arcs they represent, using the middle nodes of the CH. The shortcut
+// u->v with middle node m consists of u->m and m->v, which are arcs of m, the lowest of the three
+// nodes, and are unpacked recursively. Unpacked shortcuts are kept in a direct-mapped cache, so
+// shortcuts that appear in many paths (e.g. on motorways) are only unpacked once.
+class ShortcutUnpacker {
+
+private:
+	struct CacheEntry {
+		uint64_t key = UINT64_MAX;
+		std::vector<uint32_t> arcs;
+	};
+
+	const StaticGraph& g;
+	const ContractionHierarchy& ch;
+	std::vector<CacheEntry> cache;
+	uint64_t cache_hits = 0;
+	uint64_t cache_misses = 0;
+
+	node_t get_middle(node_t u, node_t v) const {
+		if (ch.ranking[u] < ch.ranking[v]) {
+			return ch.forward_middle[ch.forward_graph.find_arc(u, v)];
+		}
+		return ch.backward_middle[ch.backward_graph.find_arc(v, u)];
+	}
+
+public:
+	// cache_size must be a power of two.
+	ShortcutUnpacker(const StaticGraph& g, const ContractionHierarchy& ch, uint32_t cache_size = 1 << 14) : g(g), ch(ch), cache(cache_size) {}
+
+	// Appends the ids of the input arcs (in g) of the CH arc from u to v to arcs.
+	void unpack_arc(node_t u, node_t v, std::vector<uint32_t>& arcs) {
+		node_t m = get_middle(u, v);
+		if (m == invalid_id) {
+			arcs.push_back(g.find_arc(u, v));
+			return;
+		}
+		uint64_t key = arc_key(u, v);
+		CacheEntry& entry = cache[(key * 0x9E3779B97F4A7C15ull >> 32) & (cache.size() - 1)];
+		if (entry.key == key) {
+			cache_hits++;
+			arcs.insert(arcs.end(), entry.arcs.begin(), entry.arcs.end());
+			return;
+		}
+		cache_misses++;
+		size_t begin = arcs.size();
+		unpack_arc(u, m, arcs);
+		unpack_arc(m, v, arcs);
+		entry.key = key;
+		entry.arcs.assign(arcs.begin() + begin, arcs.end());
+	}
+
+	uint64_t get_cache_hits() const {
+		return cache_hits;
+	}
+
+	uint64_t get_cache_misses() const {
+		return cache_misses;
+	}
+};
+
+// QueueT can be any addressable queue with the interface of MinIDQueue, e.g. RadixIDQueue.
+template <class QueueT = MinIDQueue>
 class CHQueryService {
 
 private:
 
-	const Graph& g;
+	const StaticGraph& g;
 	const ContractionHierarchy& ch;
-	MinIDQueue forward_queue, backward_queue;
+	QueueT forward_queue, backward_queue;
 	TimestampVector<uint32_t> dist_vec_forward, dist_vec_backward;
+	TimestampVector<node_t> parent_forward, parent_backward;
 	BoolSet forward_search_space, backward_search_space;
+	ShortcutUnpacker unpacker;
 	uint32_t tentative_dist = inf_weight;
 	node_t best_node = invalid_id;
 
 	void step_forward() {
 		node_t best = forward_queue.pop().id;
 		forward_search_space.set(best);
+		count_settled(StatsScope::CH_QUERY);
+		count_relaxed(StatsScope::CH_QUERY, ch.forward_graph.get_out_arcs(best).size());
 		if (backward_search_space.has(best)) {
 			if (dist_vec_forward.get(best) + dist_vec_backward.get(best) < tentative_dist) {
 				tentative_dist = dist_vec_forward.get(best) + dist_vec_backward.get(best);
 				best_node = best;
 			}
 		}
-		const std::vector<Edge>& arcs = ch.forward_graph.get_out_arcs(best);
-		for (const Edge& e : arcs) {
+		for (const Edge& e : ch.forward_graph.get_out_arcs(best)) {
 			if (dist_vec_forward.get(best) + e.weight < dist_vec_forward.get(e.target)) {
 				dist_vec_forward.set(e.target, dist_vec_forward.get(best) + e.weight);
+				parent_forward.set(e.target, best);
 				if (!forward_queue.contains_id(e.target)) {
 					forward_queue.push({ e.target, dist_vec_forward.get(e.target) });
+					count_push(StatsScope::CH_QUERY);
 				} else {
 					forward_queue.decrease_key({ e.target, dist_vec_forward.get(e.target) });
+					count_decrease_key(StatsScope::CH_QUERY);
 				}
 			}
 		}
@@ -172,20 +684,24 @@ private:
 	void step_backward() {
 		node_t best = backward_queue.pop().id;
 		backward_search_space.set(best);
+		count_settled(StatsScope::CH_QUERY);
+		count_relaxed(StatsScope::CH_QUERY, ch.backward_graph.get_out_arcs(best).size());
 		if (forward_search_space.has(best)) {
 			if (dist_vec_forward.get(best) + dist_vec_backward.get(best) < tentative_dist) {
 				tentative_dist = dist_vec_forward.get(best) + dist_vec_backward.get(best);
 				best_node = best;
 			}
 		}
-		const std::vector<Edge>& arcs = ch.backward_graph.get_out_arcs(best);
-		for (const Edge& e : arcs) {
+		for (const Edge& e : ch.backward_graph.get_out_arcs(best)) {
 			if (dist_vec_backward.get(best) + e.weight < dist_vec_backward.get(e.target)) {
 				dist_vec_backward.set(e.target, dist_vec_backward.get(best) + e.weight);
+				parent_backward.set(e.target, best);
 				if (!backward_queue.contains_id(e.target)) {
 					backward_queue.push({ e.target, dist_vec_backward.get(e.target) });
+					count_push(StatsScope::CH_QUERY);
 				} else {
 					backward_queue.decrease_key({ e.target, dist_vec_backward.get(e.target) });
+					count_decrease_key(StatsScope::CH_QUERY);
 				}
 			}
 		}
@@ -195,15 +711,18 @@ private:
 
 public:
 
-	CHQueryService(const Graph& g, const ContractionHierarchy& ch) :
+	CHQueryService(const StaticGraph& g, const ContractionHierarchy& ch) :
 		g(g),
 		ch(ch),
 		forward_queue(g.size()),
 		backward_queue(g.size()),
 		dist_vec_forward(g.size(), inf_weight), 
 		dist_vec_backward(g.size(), inf_weight),
+		parent_forward(g.size(), invalid_id),
+		parent_backward(g.size(), invalid_id),
 		forward_search_space(g.size()),
-		backward_search_space(g.size())
+		backward_search_space(g.size()),
+		unpacker(g, ch)
 	{
 
 	}
@@ -214,6 +733,8 @@ public:
 		backward_queue.push({ t, 0 });
 		dist_vec_forward.set(s, 0);
 		dist_vec_backward.set(t, 0);
+		parent_forward.set(s, invalid_id);
+		parent_backward.set(t, invalid_id);
 		tentative_dist = inf_weight;
 		best_node = invalid_id;
 		// Query
@@ -236,14 +757,55 @@ public:
 		// Cleanup
 		forward_queue.clear();
 		backward_queue.clear();
+		forward_search_space.clear();
+		backward_search_space.clear();
 		dist_vec_forward.step_time();
 		dist_vec_backward.step_time();
 		return tentative_dist;
 	}
 
+	// Runs query and returns the path in g, i.e. with all shortcuts unpacked, including the arc ids.
+	// The CH needs middle nodes (see compute_middle_nodes).
+	Path query_path(node_t s, node_t t) {
+		if (!ch.has_middle_nodes()) {
+			throw std::runtime_error("Paths need a CH with middle nodes");
+		}
+		uint32_t length = query(s, t);
+		Path ret = { std::vector<node_t>(), length, std::vector<uint32_t>() };
+		if (length == inf_weight) {
+			return ret;
+		}
+		// The parents are still valid, only the distances are reset
+		std::vector<node_t> ch_path;
+		for (node_t n = best_node; n != invalid_id; n = parent_forward.get(n)) {
+			ch_path.push_back(n);
+		}
+		std::reverse(ch_path.begin(), ch_path.end());
+		for (node_t n = parent_backward.get(best_node); n != invalid_id; n = parent_backward.get(n)) {
+			ch_path.push_back(n);
+		}
+		for (uint32_t i = 0; i + 1 < ch_path.size(); i++) {
+			unpacker.unpack_arc(ch_path[i], ch_path[i + 1], ret.edges);
+		}
+		ret.nodes.push_back(s);
+		for (uint32_t arc : ret.edges) {
+			ret.nodes.push_back(g.get_head()[arc]);
+		}
+		return ret;
+	}
+
+	const ShortcutUnpacker& get_unpacker() const {
+		return unpacker;
+	}
+
+	// Nodes still recorded in the search spaces, 0 between queries
+	uint32_t get_retained_nodes() const {
+		return forward_search_space.size() + backward_search_space.size();
+	}
+
 };
 
-Path dijkstra_on_ch(node_t start, node_t end, DijkstraService& forward_service, DijkstraService& backward_service, uint32_t graph_size, bool calculate_path = true) {
+Path dijkstra_on_ch(node_t start, node_t end, DijkstraService<StaticGraph>& forward_service, DijkstraService<StaticGraph>& backward_service, uint32_t graph_size, bool calculate_path = true) {
 	Timer timer;
 	timer.lap();
 	forward_service.set_source(start);
@@ -1,31 +1,40 @@
 #pragma once
 
 #include "graph.h"
+#include "static_graph.h"
 #include "timestamp_vector.h"
-#include "base/id_queue.h"
-#include "base/constants.h"
+#include "id_queue.h"
+#include "constants.h"
+#include "search_stats.h"
 #include <queue>
 #include <utility>
 #include <ctype.h>
+#include <algorithm>
 
+// Works on both Graph and StaticGraph. QueueT can be any addressable queue with the
+// interface of MinIDQueue. stats_scope is the engine its operations are counted for.
+template <class GraphT, class QueueT = MinIDQueue>
 class DijkstraService {
 
 	private:
-		const Graph& g;
+		const GraphT& g;
 		TimestampVector<node_t> dist_vec;
 		TimestampVector<node_t> parent_vec;
-		MinIDQueue queue;
+		TimestampVector<uint32_t> parent_arc_vec; // Only filled if GraphT has arc ids
+		QueueT queue;
 		node_t blacklisted = invalid_id;
 		uint32_t max_dist = inf_weight;
 		std::vector<node_t> search_space;
+		StatsScope stats_scope;
 
 	public:
-		DijkstraService(const Graph& _g) : g(_g), dist_vec(_g.size(), inf_weight), parent_vec(_g.size(), invalid_id), queue(_g.size()) {}
+		DijkstraService(const GraphT& _g, StatsScope stats_scope = StatsScope::DIJKSTRA) : g(_g), dist_vec(_g.size(), inf_weight), parent_vec(_g.size(), invalid_id), parent_arc_vec(_g.size(), invalid_id), queue(_g.size()), stats_scope(stats_scope) {}
 
 		void set_source(node_t source) {
 			dist_vec.set(source, 0);
 			parent_vec.set(source, invalid_id);
 			queue.push({ source, 0 });
+			count_push(stats_scope);
 		}
 
 		void set_blacklisted(node_t n) {
@@ -39,18 +48,26 @@ class DijkstraService {
 		node_t step() {
 			node_t best = queue.pop().id;
 			search_space.push_back(best);
-			const std::vector<Edge>& neighbours = g.get_out_arcs(best);
-			for (auto i = neighbours.begin(); i < neighbours.end(); i++) {
-				if (i->target == blacklisted) {
+			count_settled(stats_scope);
+			count_relaxed(stats_scope, g.get_out_arcs(best).size());
+			uint32_t i = 0;
+			for (const Edge& e : g.get_out_arcs(best)) {
+				uint32_t arc_index = i++;
+				if (e.target == blacklisted) {
 					continue;
 				}
-				if (dist_vec.get(best) + i->weight < dist_vec.get(i->target)) {
-					dist_vec.set(i->target, dist_vec.get(best) + i->weight);
-					parent_vec.set(i->target, best);
-					if (!queue.contains_id(i->target)) {
-						queue.push({ i->target, dist_vec.get(i->target) });
+				if (dist_vec.get(best) + e.weight < dist_vec.get(e.target)) {
+					dist_vec.set(e.target, dist_vec.get(best) + e.weight);
+					parent_vec.set(e.target, best);
+					if constexpr (has_arc_ids<GraphT>) {
+						parent_arc_vec.set(e.target, g.get_out_arc_id(best, arc_index));
+					}
+					if (!queue.contains_id(e.target)) {
+						queue.push({ e.target, dist_vec.get(e.target) });
+						count_push(stats_scope);
 					} else {
-						queue.decrease_key({ i->target, dist_vec.get(i->target) });
+						queue.decrease_key({ e.target, dist_vec.get(e.target) });
+						count_decrease_key(stats_scope);
 					}
 				}
 			}
@@ -81,18 +98,24 @@ class DijkstraService {
 			return dist_vec.get(n);
 		}
 
+		// Path::edges is only filled if GraphT has arc ids.
 		Path get_path(node_t target) {
-			std::vector<node_t> path;
-			uint32_t dist = get_dist(target);
-			if (dist == inf_weight) {
-				return { std::vector<node_t>(), dist };
+			Path ret = { std::vector<node_t>(), get_dist(target), std::vector<uint32_t>() };
+			if (ret.length == inf_weight) {
+				return ret;
 			}
 			while (target != invalid_id) {
-				path.push_back(target);
+				ret.nodes.push_back(target);
+				if constexpr (has_arc_ids<GraphT>) {
+					if (parent_vec.get(target) != invalid_id) {
+						ret.edges.push_back(parent_arc_vec.get(target));
+					}
+				}
 				target = parent_vec.get(target);
 			}
-			std::reverse(path.begin(), path.end());
-			return { path, dist };
+			std::reverse(ret.nodes.begin(), ret.nodes.end());
+			std::reverse(ret.edges.begin(), ret.edges.end());
+			return ret;
 		}
 
 		const std::vector<node_t>& get_search_space() {
@@ -3,7 +3,8 @@
 #include <vector>
 #include <iostream>
 #include <ctype.h>
-#include "base/constants.h"
+#include <type_traits>
+#include "constants.h"
 
 typedef uint32_t node_t;
 
@@ -15,6 +16,7 @@ struct Edge {
 struct Path {
 	std::vector<node_t> nodes;
 	uint32_t length;
+	std::vector<uint32_t> edges; // Forward arc ids in a StaticGraph, empty if the search does not provide them
 
 	bool operator==(const Path& b) {
 		if (nodes.size() != b.nodes.size()) { return false; }
@@ -36,6 +38,8 @@ struct PathQualityResult {
 	float sharing;
 };
 
+class StaticGraph;
+
 class Graph {
 
 	private:
@@ -49,6 +53,9 @@ class Graph {
 			rev_adj_list = std::vector<std::vector<Edge>>(size);
 		}
 
+		// Defined in static_graph.h
+		explicit Graph(const StaticGraph& g);
+
 		const std::vector<Edge>& get_out_arcs(node_t n) const {
 			return adj_list[n];
 		}
@@ -200,4 +207,9 @@ class Graph {
 			}
 		}
 
-};
\ No newline at end of file
+};
+
+// Graph has no arc ids, so searches on it return paths without Path::edges. StaticGraph and
+// PenalizedGraph number their arcs.
+template <class GraphT>
+constexpr bool has_arc_ids = !std::is_same<GraphT, Graph>::value;
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "constants.h"
+#include <vector>
+#include <cstdint>
+#include <ctype.h>
+
+template <class KeyT>
+struct BasicIDKeyPair {
+	uint32_t id;
+	KeyT key;
+};
+
+typedef BasicIDKeyPair<uint32_t> IDKeyPair;
+
+// Addressable min-heap with a fixed number of children per node. Ids must be smaller than the size
+// given at construction. Every id stores its position in the heap, so decrease_key and contains_id
+// are possible. Positions of popped ids are reset immediately, so clear only touches the ids that
+// are still in the heap and not the whole id range.
+template <unsigned arity, class KeyT = uint32_t>
+class KaryIDQueue {
+
+	static_assert(arity >= 2, "Heap needs at least two children per node");
+
+	public:
+		typedef BasicIDKeyPair<KeyT> PairT;
+
+	private:
+		std::vector<PairT> heap;
+		std::vector<uint32_t> pos;
+
+		void move_up(uint32_t i) {
+			PairT p = heap[i];
+			while (i > 0) {
+				uint32_t parent = (i - 1) / arity;
+				if (!(p.key < heap[parent].key)) {
+					break;
+				}
+				heap[i] = heap[parent];
+				pos[heap[i].id] = i;
+				i = parent;
+			}
+			heap[i] = p;
+			pos[p.id] = i;
+		}
+
+		void move_down(uint32_t i) {
+			PairT p = heap[i];
+			uint32_t n = heap.size();
+			while (true) {
+				uint32_t first_child = arity * i + 1;
+				if (first_child >= n) {
+					break;
+				}
+				uint32_t last_child = first_child + arity < n ? first_child + arity : n;
+				uint32_t best_child = first_child;
+				for (uint32_t c = first_child + 1; c < last_child; c++) {
+					if (heap[c].key < heap[best_child].key) {
+						best_child = c;
+					}
+				}
+				if (!(heap[best_child].key < p.key)) {
+					break;
+				}
+				heap[i] = heap[best_child];
+				pos[heap[i].id] = i;
+				i = best_child;
+			}
+			heap[i] = p;
+			pos[p.id] = i;
+		}
+
+	public:
+		KaryIDQueue(uint32_t id_count) : pos(id_count, invalid_id) {}
+
+		bool empty() const {
+			return heap.empty();
+		}
+
+		uint32_t size() const {
+			return heap.size();
+		}
+
+		bool contains_id(uint32_t id) const {
+			return pos[id] != invalid_id;
+		}
+
+		KeyT get_key(uint32_t id) const {
+			return heap[pos[id]].key;
+		}
+
+		PairT peek() const {
+			return heap[0];
+		}
+
+		void push(PairT p) {
+			heap.push_back(p);
+			move_up(heap.size() - 1);
+		}
+
+		PairT pop() {
+			PairT ret = heap[0];
+			pos[ret.id] = invalid_id;
+			PairT last = heap.back();
+			heap.pop_back();
+			if (!heap.empty()) {
+				heap[0] = last;
+				move_down(0);
+			}
+			return ret;
+		}
+
+		// The new key must not be larger than the old one.
+		void decrease_key(PairT p) {
+			uint32_t i = pos[p.id];
+			heap[i].key = p.key;
+			move_up(i);
+		}
+
+		// The new key may be smaller or larger than the old one.
+		void change_key(PairT p) {
+			uint32_t i = pos[p.id];
+			KeyT old_key = heap[i].key;
+			heap[i].key = p.key;
+			if (p.key < old_key) {
+				move_up(i);
+			} else {
+				move_down(i);
+			}
+		}
+
+		void clear() {
+			for (const PairT& p : heap) {
+				pos[p.id] = invalid_id;
+			}
+			heap.clear();
+		}
+};
+
+typedef KaryIDQueue<2> BinaryIDQueue;
+typedef KaryIDQueue<4> QuaternaryIDQueue;
+typedef KaryIDQueue<8> OctonaryIDQueue;
+
+// Default queue for all searches.
+typedef QuaternaryIDQueue MinIDQueue;
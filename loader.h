@@ -1,32 +1,189 @@
 #pragma once
 
 #include "graph.h"
-#include "base/vector_io.h"
+#include "static_graph.h"
+#include "vector_io.h"
 #include "util.h"
 #include "contraction.h"
 #include <string>
+#include <fstream>
+#include <filesystem>
+#include <cstdio>
 #include <ctype.h>
 #include <iostream>
 #include <aixlog.hpp>
 
-Graph read_graph(const std::string& path) {
-	std::vector<uint32_t> first_out = load_vector<uint32_t>(path + "first_out");
-	std::vector<uint32_t> head = load_vector<uint32_t>(path + "head");
-	std::vector<uint32_t> weight = load_vector<uint32_t>(path + "weight");
+// The vectors are memory mapped and used as they are, so loading does no per-edge work. Only callers
+// that search backwards need with_reverse, which builds the reverse arrays in memory. The check for
+// parallel arcs sorts every adjacency list, so it is opt-in; if the graph has some, it is copied
+// into memory to remove them. contract always checks, so a CH it built for a graph with parallel arcs
+// only matches the graph if it is read with remove_parallel.
+StaticGraph read_graph(const std::string& path, bool with_reverse = false, bool remove_parallel = false) {
+	MappedVector<uint32_t> first_out = map_vector<uint32_t>(path + "first_out");
+	MappedVector<uint32_t> head = map_vector<uint32_t>(path + "head");
+	MappedVector<uint32_t> weight = map_vector<uint32_t>(path + "weight");
 	LOG(INFO) << "fo: " << first_out.size() << ", head: " << head.size() << ", w: " << weight.size() << "\n";
-	Graph g(first_out.size() - 1);
-	for (uint32_t i = 0; i < first_out.size() - 1; i++) {
-		for (uint32_t j = first_out[i]; j < first_out[i + 1]; j++) {
-			g.add_edge(i, { head[j], weight[j] });
-		}
+	if (first_out.empty() || first_out.back() != head.size() || head.size() != weight.size()) {
+		throw std::runtime_error("Graph vectors in " + path + " have inconsistent sizes");
+	}
+	if (remove_parallel && has_parallel_arcs(first_out, head)) {
+		LOG(INFO) << "Graph has parallel arcs, removing them...\n";
+		std::vector<uint32_t> _first_out = first_out.to_vector();
+		std::vector<uint32_t> _head = head.to_vector();
+		std::vector<uint32_t> _weight = weight.to_vector();
+		remove_parallel_arcs(_first_out, _head, _weight);
+		return StaticGraph(std::move(_first_out), std::move(_head), std::move(_weight), with_reverse);
+	}
+	return StaticGraph(std::move(first_out), std::move(head), std::move(weight), with_reverse);
+}
+
+void fnv1a_add(uint64_t& hash, uint32_t value) {
+	for (int i = 0; i < 4; i++) {
+		hash = (hash ^ ((value >> (8 * i)) & 0xFF)) * 1099511628211ull;
+	}
+}
+
+// With full, every element is hashed. Otherwise only the size and at most 1024 evenly spaced
+// elements, which touches a few pages of a mapped vector instead of all of them.
+template <class VectorT>
+void fnv1a_add(uint64_t& hash, const VectorT& vec, bool full) {
+	uint64_t size = vec.size();
+	fnv1a_add(hash, (uint32_t)size);
+	fnv1a_add(hash, (uint32_t)(size >> 32));
+	size_t step = full ? 1 : std::max<size_t>(1, vec.size() / 1024);
+	for (size_t i = 0; i < vec.size(); i += step) {
+		fnv1a_add(hash, vec[i]);
+	}
+	if (!vec.empty()) {
+		fnv1a_add(hash, vec.back());
 	}
-	return g;
 }
 
-ContractionHierarchy read_ch(const std::string& ch_path) {
-	Graph g = read_graph(ch_path);
+// FNV-1a hash of the arc arrays, identifies the graph a CH was built for. Without full it is only
+// a fingerprint, see fnv1a_add.
+uint64_t graph_checksum(const StaticGraph& g, bool full) {
+	uint64_t hash = 14695981039346656037ull;
+	fnv1a_add(hash, g.get_first_out(), full);
+	fnv1a_add(hash, g.get_head(), full);
+	fnv1a_add(hash, g.get_weight(), full);
+	return hash;
+}
+
+// The same for the vectors of a CH in the RoutingKit format, as they are stored.
+template <class VectorT>
+uint64_t ch_checksum(const VectorT& first_out, const VectorT& head, const VectorT& weight, const VectorT& order, bool full) {
+	uint64_t hash = 14695981039346656037ull;
+	fnv1a_add(hash, first_out, full);
+	fnv1a_add(hash, head, full);
+	fnv1a_add(hash, weight, full);
+	fnv1a_add(hash, order, full);
+	return hash;
+}
+
+// Checksums written by write_ch: fingerprint and full checksum of the graph, then of the CH.
+// Empty if there are none or they do not belong to the CH in ch_path, e.g. because RoutingKit
+// overwrote the CH and left the old files behind. middle is only used if this is not empty.
+// Only the fingerprint of the CH is compared unless verify is set.
+std::vector<uint64_t> load_ch_checksums(const std::string& ch_path, bool verify) {
+	if (!std::ifstream(ch_path + "graph_checksum")) {
+		return {};
+	}
+	std::vector<uint64_t> checksums = load_vector<uint64_t>(ch_path + "graph_checksum");
+	MappedVector<uint32_t> first_out = map_vector<uint32_t>(ch_path + "first_out");
+	MappedVector<uint32_t> head = map_vector<uint32_t>(ch_path + "head");
+	MappedVector<uint32_t> weight = map_vector<uint32_t>(ch_path + "weight");
+	MappedVector<uint32_t> order = map_vector<uint32_t>(ch_path + "order");
+	if (checksums.size() != 4 || checksums[2] != ch_checksum(first_out, head, weight, order, false)
+		|| (verify && checksums[3] != ch_checksum(first_out, head, weight, order, true))) {
+		LOG(WARNING) << "graph_checksum in " << ch_path << " does not belong to the CH, ignoring it and middle\n";
+		return {};
+	}
+	return checksums;
+}
+
+ContractionHierarchy read_ch_vectors(const std::string& ch_path, bool with_middle) {
+	StaticGraph g = read_graph(ch_path, false);
 	std::vector<uint32_t> ranking = order_to_ranking(load_vector<uint32_t>(ch_path + "order"));
-	auto split = split_graph(g, ranking);
-	ContractionHierarchy ret = { split.first, split.second, ranking };
-	return ret;
+	std::vector<node_t> middle;
+	if (with_middle && std::ifstream(ch_path + "middle")) {
+		middle = load_vector<node_t>(ch_path + "middle");
+		if (middle.size() != g.n_edges()) {
+			throw std::runtime_error("Middle node vector in " + ch_path + " does not match the arcs");
+		}
+	}
+	return build_ch(g, ranking, middle);
+}
+
+// Reads a CH in the RoutingKit format: first_out, head and weight of the graph with all input arcs
+// and shortcuts, and order. The optional middle vector (see write_ch) holds the middle node of
+// every arc.
+ContractionHierarchy read_ch(const std::string& ch_path, bool verify = false) {
+	return read_ch_vectors(ch_path, !load_ch_checksums(ch_path, verify).empty());
+}
+
+// Also checks that the CH was built for g, if it was written with checksums. By default only the
+// fingerprints are compared, verify hashes all arcs of the graph and the CH.
+ContractionHierarchy read_ch(const std::string& ch_path, const StaticGraph& g, bool verify = false) {
+	std::vector<uint64_t> checksums = load_ch_checksums(ch_path, verify);
+	if (!checksums.empty() && (checksums[0] != graph_checksum(g, false) || (verify && checksums[1] != graph_checksum(g, true)))) {
+		throw std::runtime_error("CH in " + ch_path + " was built for a different graph (or for this one without parallel arcs, see --remove-parallel-arcs)");
+	}
+	ContractionHierarchy ch = read_ch_vectors(ch_path, !checksums.empty());
+	if (ch.ranking.size() != g.size()) {
+		throw std::runtime_error("CH in " + ch_path + " has " + std::to_string(ch.ranking.size()) + " nodes, the graph " + std::to_string(g.size()));
+	}
+	return ch;
+}
+
+// Writes ch in the format of read_ch, so it can be used instead of a RoutingKit CH. Additionally
+// writes middle (the middle node of every arc, invalid_id for input arcs) if ch has middle nodes
+// and graph_checksum, the fingerprints and checksums of the input graph g and of the written CH.
+void write_ch(const std::string& ch_path, const ContractionHierarchy& ch, const StaticGraph& g) {
+	uint32_t n = ch.ranking.size();
+	std::vector<uint32_t> first_out(n + 1, 0);
+	for (node_t u = 0; u < n; u++) {
+		first_out[u + 1] += ch.forward_graph.get_out_arcs(u).size();
+		for (const Edge& e : ch.backward_graph.get_out_arcs(u)) {
+			first_out[e.target + 1]++;
+		}
+	}
+	for (node_t u = 0; u < n; u++) {
+		first_out[u + 1] += first_out[u];
+	}
+	std::vector<uint32_t> head(first_out.back()), weight(first_out.back()), middle(first_out.back(), invalid_id);
+	std::vector<uint32_t> insert_pos(first_out.begin(), first_out.end() - 1);
+	auto insert = [&](node_t u, node_t v, uint32_t w, const std::vector<node_t>& middle_vec, uint32_t arc) {
+		uint32_t pos = insert_pos[u]++;
+		head[pos] = v;
+		weight[pos] = w;
+		if (!middle_vec.empty()) {
+			middle[pos] = middle_vec[arc];
+		}
+	};
+	for (node_t u = 0; u < n; u++) {
+		uint32_t arc = ch.forward_graph.get_out_arc_id(u, 0);
+		for (const Edge& e : ch.forward_graph.get_out_arcs(u)) {
+			insert(u, e.target, e.weight, ch.forward_middle, arc++);
+		}
+		arc = ch.backward_graph.get_out_arc_id(u, 0);
+		for (const Edge& e : ch.backward_graph.get_out_arcs(u)) {
+			insert(e.target, u, e.weight, ch.backward_middle, arc++);
+		}
+	}
+	std::vector<node_t> order(n);
+	for (node_t u = 0; u < n; u++) {
+		order[ch.ranking[u]] = u;
+	}
+	std::filesystem::create_directories(ch_path);
+	save_vector(ch_path + "first_out", first_out);
+	save_vector(ch_path + "head", head);
+	save_vector(ch_path + "weight", weight);
+	save_vector(ch_path + "order", order);
+	if (ch.has_middle_nodes()) {
+		save_vector(ch_path + "middle", middle);
+	} else {
+		std::remove((ch_path + "middle").c_str());
+	}
+	save_vector(ch_path + "graph_checksum", std::vector<uint64_t>{ graph_checksum(g, false), graph_checksum(g, true),
+		ch_checksum(first_out, head, weight, order, false), ch_checksum(first_out, head, weight, order, true) });
 }
\ No newline at end of file
@@ -10,58 +10,92 @@
 #include "performance_logger.h"
 #include "visualisation.h"
 #include "xbdv.h"
+#include "rphast.h"
+#include "boolset.h"
+#include "work_stealing_queue.h"
+#include "result_writer.h"
+#include "search_stats.h"
 #include <iostream>
 #include <fstream>
 #include <optional>
 #include <random>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
 
-PathQualityResult get_path_quality(const Graph& g, const ContractionHierarchy& ch, const Path& path, float alpha) {
-	PathQualityResult ret;
-	ret.length = path.length;
-	DijkstraService dijkstra(g);
-	// Sharing
-	dijkstra.set_source(path.nodes.front());
-	dijkstra.run_until_target_found(path.nodes.back());
-	Path optimal_path = dijkstra.get_path(path.nodes.back());
-	dijkstra.finish();
-	uint32_t shared_dist = 0;
-	for (uint32_t i = 1; i < path.nodes.size(); i++) {
-		if (std::find(optimal_path.nodes.begin(), optimal_path.nodes.end(), path.nodes[i]) != optimal_path.nodes.end()) {
-			shared_dist += g.get_edge_weight(path.nodes[i - 1], path.nodes[i]);
+struct STCase {
+	uint32_t index;
+	node_t source;
+	node_t target;
+	uint32_t dijkstra_rank;
+};
+
+// Evaluates alternative paths. Shortest path distances between path nodes are computed with RPHAST,
+// so the CH is only swept on the upward closure of the path instead of the whole graph.
+class PathQualityService {
+
+private:
+	const StaticGraph& g;
+	DijkstraService<StaticGraph> dijkstra;
+	RPHASTService rphast;
+	BoolSet optimal_path_nodes;
+
+public:
+	PathQualityService(const StaticGraph& g, const ContractionHierarchy& ch) : g(g), dijkstra(g), rphast(ch), optimal_path_nodes(g.size()) {}
+
+	PathQualityResult get_path_quality(const Path& path, float alpha) {
+		PathQualityResult ret;
+		ret.length = path.length;
+		// Sharing
+		dijkstra.set_source(path.nodes.front());
+		dijkstra.run_until_target_found(path.nodes.back());
+		Path optimal_path = dijkstra.get_path(path.nodes.back());
+		dijkstra.finish();
+		optimal_path_nodes.clear();
+		for (node_t n : optimal_path.nodes) {
+			optimal_path_nodes.set(n);
 		}
-	}
-	ret.sharing = (float)shared_dist / optimal_path.length;
-	ret.stretch = (float)path.length / optimal_path.length;
-	// Local optimality and uniformly bounded stretch (could be calculated by hand)
-	CHPotentialService potentials(ch);
-	float worst_ubs = 1;
-	uint32_t min_dist_without_local_optimality = path.length;
-	for (int i = path.nodes.size() - 1; i >= 1; i--) {
-		uint32_t path_dist = 0;
-		potentials.set_target(path.nodes[i]);
-		for (int j = i - 1; j >= 0; j--) {
-			path_dist += g.get_edge_weight(path.nodes[j], path.nodes[j + 1]);
-			uint32_t optimal_dist = potentials(path.nodes[j]);
-			if (path_dist != optimal_dist && path_dist < min_dist_without_local_optimality) {
-				min_dist_without_local_optimality = path_dist;
+		uint32_t shared_dist = 0;
+		for (uint32_t i = 1; i < path.nodes.size(); i++) {
+			if (optimal_path_nodes.has(path.nodes[i])) {
+				shared_dist += g.get_edge_weight(path.nodes[i - 1], path.nodes[i]);
 			}
-			float stretch = (float)path_dist / optimal_dist;
-			if (stretch > worst_ubs) {
-				worst_ubs = stretch;
+		}
+		ret.sharing = (float)shared_dist / optimal_path.length;
+		ret.stretch = (float)path.length / optimal_path.length;
+		// Local optimality and uniformly bounded stretch (could be calculated by hand)
+		rphast.select_sources(path.nodes);
+		float worst_ubs = 1;
+		uint32_t min_dist_without_local_optimality = path.length;
+		for (int i = path.nodes.size() - 1; i >= 1; i--) {
+			uint32_t path_dist = 0;
+			rphast.run(path.nodes[i]);
+			for (int j = i - 1; j >= 0; j--) {
+				path_dist += g.get_edge_weight(path.nodes[j], path.nodes[j + 1]);
+				uint32_t optimal_dist = rphast.get_dist(path.nodes[j]);
+				if (path_dist != optimal_dist && path_dist < min_dist_without_local_optimality) {
+					min_dist_without_local_optimality = path_dist;
+				}
+				float stretch = (float)path_dist / optimal_dist;
+				if (stretch > worst_ubs) {
+					worst_ubs = stretch;
+				}
 			}
 		}
+		ret.uniformly_bounded_stretch = worst_ubs;
+		ret.local_optimality = (float)min_dist_without_local_optimality / path.length;
+		return ret;
 	}
-	ret.uniformly_bounded_stretch = worst_ubs;
-	ret.local_optimality = (float)min_dist_without_local_optimality / path.length;
-	return ret;
-}
+};
 
 class ApplicationService {
 
 private:
-	const Graph& g;
-	std::queue<std::tuple<node_t, node_t, uint32_t>> work_queue;
+	const StaticGraph& g;
 	PenaltyService penalty_service;
+	XBDVService<Graph> xbdv_service; // Works on the alternative graph of penalty_service, which is reused for every case
 	const Graph* alternative_graph = NULL;
 	std::optional<std::vector<float>> latitude_vec;
 	std::optional<std::vector<float>> longitude_vec;
@@ -70,7 +104,8 @@ private:
 
 public:
 
-	ApplicationService(const Graph& g, const ContractionHierarchy& ch) : g(g), penalty_service(g, ch) 
+	ApplicationService(const StaticGraph& g, const ContractionHierarchy& ch, PotentialMode potential_mode = PotentialMode::LAZY, BidirectionalMode search_mode = BidirectionalMode::PARALLEL, const CCHTopology* cch_topology = nullptr, bool ch_first_path = false) : g(g), penalty_service(g, ch, potential_mode, search_mode, cch_topology, ch_first_path),
+		xbdv_service(penalty_service.get_alt_graph())
 	{}
 
 	void set_params(float alpha, float eps, float pen) {
@@ -79,26 +114,21 @@ public:
 		penalty_service.set_penalty_factor(pen);
 	}
 
-	void add_source_target_pair(node_t source, node_t target, uint32_t dijkstra_rank = 0) {
-		work_queue.push(std::make_tuple(source, target, dijkstra_rank));
-	}
-
 	void supply_coordinate_vectors(const std::vector<float>& latitude_vec, const std::vector<float> longitude_vec) {
 		this->latitude_vec.emplace(latitude_vec);
 		this->longitude_vec.emplace(longitude_vec);
 	}
 
-	void run_iteration() {
+	void run_iteration(const STCase& st_case) {
 		Timer timer;
 		global_performance_logger.begin_test_case();
-		auto current_tuple = work_queue.front();
-		work_queue.pop();
-		node_t source = std::get<0>(current_tuple);
-		node_t target = std::get<1>(current_tuple);
+		node_t source = st_case.source;
+		node_t target = st_case.target;
 		current_source = source;
 		current_target = target;
-		uint32_t rank = std::get<2>(current_tuple);
+		uint32_t rank = st_case.dijkstra_rank;
 		LOG(INFO) << "Running Iteration: source = " << source << ", target = " << target << ", rank = " << rank << "\n";
+		global_performance_logger.set_case_index(st_case.index);
 		global_performance_logger.set_source(source);
 		global_performance_logger.set_target(target);
 		global_performance_logger.set_dijkstra_rank(rank);
@@ -114,7 +144,6 @@ public:
 		if (alternative_graph == NULL) {
 			return std::vector<Path>();
 		}
-		XBDVService xbdv_service(*alternative_graph);
 		return xbdv_service.run_bdv(current_source, current_target, false);
 	}
 
@@ -136,10 +165,6 @@ public:
 		global_performance_logger.finish_test_case();
 	}
 
-	bool is_done() {
-		return work_queue.empty();
-	}
-
 	node_t get_current_source() { return current_source; }
 	node_t get_current_target() { return current_target; }
 };
@@ -164,17 +189,27 @@ int run_penalty_mode(int argn, char** argv) {
 		("o,output", "Path to output folder. Default: Working directory", cxxopts::value<std::string>())
 		("s,source", "Source Node ID", cxxopts::value<node_t>())
 		("t,target", "Target Node ID", cxxopts::value<node_t>())
-		("q, quality", "Logs path quality values like uniformly bounded stretch. Takes a LOT of time.")
+		("q, quality", "Logs path quality values like uniformly bounded stretch. Uses RPHAST on the path nodes.")
 		("source-vector", "Path to a source vector, overrides source option", cxxopts::value<std::string>())
 		("target-vector", "Path to a target vector, overrides target option", cxxopts::value<std::string>())
 		("rank-vector", "Path to optional rank vector", cxxopts::value<std::string>())
 		("source-limit", "Limits amount of nodes to process from source vector", cxxopts::value<uint32_t>())
 		("draw-images", "Draws an image of the graph and the found alternative route graph to output folder; Requires coordinate vectors in input folder")
+		("phast", "Computes all CH potentials per target with a PHAST sweep instead of lazily")
+		("interleaved", "Runs both directions of the bidirectional A* on one thread instead of two")
+		("threads", "Number of worker threads that process the source-target pairs (default: 1, 0: all cores)", cxxopts::value<uint32_t>())
+		("cch", "Re-customizes the CH potentials to the penalized weights after every penalty step (CCH with a nested dissection order)")
+		("ch-first-path", "Finds the shortest path with a CH query and unpacked shortcuts instead of the first A*")
+		("verify-ch", "Checks graph_checksum of the CH with a hash of all arcs instead of a sampled fingerprint")
+		("remove-parallel-arcs", "Checks the graph for parallel arcs and keeps only the shortest of them")
 		("min-dijkstra-rank", "Sets minimum dijkstra rank to run and log", cxxopts::value<uint32_t>())
 		("alpha", "Sets factor for rejoin penalty (default: 0.5)", cxxopts::value<float>())
 		("eps", "Sets stretch value in penalty method (default: 0.1)", cxxopts::value<float>())
 		("pen", "Sets penalty factor (default 0.04)", cxxopts::value<float>())
-		("logname", "Sets name of log file (to prevent overwriting)", cxxopts::value<std::string>());
+		("logname", "Sets name of log file (to prevent overwriting)", cxxopts::value<std::string>())
+		("log-format", "Format of the log file: json (default), jsonl, csv or binary (one vector file per metric). jsonl and csv are written while running", cxxopts::value<std::string>())
+		("resume", "Continues an existing jsonl or csv log file and skips the cases already in it")
+		("perf-counters", "Logs hardware counters (cycles, instructions, cache and branch misses) per phase, if the system allows it");
 	;
 	auto parse_result = options.parse(argn, argv);
 	// Load penalty settings
@@ -182,22 +217,60 @@ int run_penalty_mode(int argn, char** argv) {
 	float eps = (parse_result.count("eps") != 0) ? parse_result["eps"].as<float>() : 0.1;
 	float pen = (parse_result.count("pen") != 0) ? parse_result["pen"].as<float>() : 0.04;
 	std::string logname = (parse_result.count("logname") != 0) ? parse_result["logname"].as<std::string>() : "log";
+	LogFormat log_format = LogFormat::JSON;
+	if (parse_result.count("log-format") != 0) {
+		std::string format_name = parse_result["log-format"].as<std::string>();
+		if (format_name == "jsonl") {
+			log_format = LogFormat::JSONL;
+		} else if (format_name == "csv") {
+			log_format = LogFormat::CSV;
+		} else if (format_name == "binary") {
+			log_format = LogFormat::BINARY;
+		} else if (format_name != "json") {
+			LOG(ERROR) << "Unknown log format: " << format_name << "\n";
+			return 1;
+		}
+	}
+	bool resume = (parse_result.count("resume") != 0);
+	perf_counters_enabled.store(parse_result.count("perf-counters") != 0);
+	if (resume && (log_format == LogFormat::JSON || log_format == LogFormat::BINARY)) {
+		LOG(ERROR) << "--resume needs --log-format jsonl or csv\n";
+		return 1;
+	}
 	// Load graph and ch
 	std::string input_path = parse_result["input"].as<std::string>();
 	if (input_path.back() != '/') {
 		input_path.push_back('/');
 	}
-	Graph g = read_graph(input_path);
-	ContractionHierarchy ch = read_ch(input_path + "ch/");
-	ApplicationService executor(g, ch);
-	executor.set_params(alpha, eps, pen);
-	bool draw_images = false;
+	StaticGraph g = read_graph(input_path, true, parse_result.count("remove-parallel-arcs") != 0);
+	ContractionHierarchy ch = read_ch(input_path + "ch/", g, parse_result.count("verify-ch") != 0);
+	PotentialMode potential_mode = (parse_result.count("phast") != 0) ? PotentialMode::PHAST : PotentialMode::LAZY;
+	BidirectionalMode search_mode = (parse_result.count("interleaved") != 0) ? BidirectionalMode::INTERLEAVED : BidirectionalMode::PARALLEL;
+	// Built once, the workers only keep their own metric
+	std::unique_ptr<CCHTopology> cch_topology;
+	if (parse_result.count("cch") != 0) {
+		try {
+			cch_topology.reset(new CCHTopology(g));
+		} catch (const std::runtime_error& e) {
+			LOG(ERROR) << e.what() << "\n";
+			return 1;
+		}
+	}
+	bool ch_first_path = parse_result.count("ch-first-path") != 0;
+	if (ch_first_path && !ch.has_middle_nodes()) {
+		LOG(INFO) << "CH has no middle nodes, computing them...\n";
+		compute_middle_nodes(ch, g);
+	}
+	uint32_t thread_count = (parse_result.count("threads") != 0) ? parse_result["threads"].as<uint32_t>() : 1;
+	if (thread_count == 0) {
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+	}
+	bool draw_images = (parse_result.count("draw-images") != 0);
 	bool log_quality = (parse_result.count("q") != 0);
-	if (parse_result.count("draw-images") != 0) {
-		draw_images = true;
-		std::vector<float> latitude_vector = load_vector<float>(input_path + "latitude");
-		std::vector<float> longitude_vector = load_vector<float>(input_path + "longitude");
-		executor.supply_coordinate_vectors(latitude_vector, longitude_vector);
+	std::vector<float> latitude_vector, longitude_vector;
+	if (draw_images) {
+		latitude_vector = load_vector<float>(input_path + "latitude");
+		longitude_vector = load_vector<float>(input_path + "longitude");
 	}
 	// Get output path
 	std::string output_path = "./";
@@ -208,8 +281,9 @@ int run_penalty_mode(int argn, char** argv) {
 		}
 	}
 	// Supply sources and targets
+	std::vector<STCase> cases;
 	if (parse_result.count("source") != 0 && parse_result.count("target") != 0) {
-		executor.add_source_target_pair(parse_result["source"].as<node_t>(), parse_result["target"].as<node_t>());
+		cases.push_back({ 0, parse_result["source"].as<node_t>(), parse_result["target"].as<node_t>(), 0 });
 	} else if (parse_result.count("source-vector") != 0 && parse_result.count("target-vector") != 0) {
 		std::vector<node_t> sources = load_vector<node_t>(parse_result["source-vector"].as<std::string>());
 		std::vector<node_t> targets = load_vector<node_t>(parse_result["target-vector"].as<std::string>());
@@ -225,38 +299,121 @@ int run_penalty_mode(int argn, char** argv) {
 			LOG(ERROR) << "Source and rank vector don't have same size!\n";
 			return 1;
 		}
-		for (int i = 0; i < sources.size(); i++) {
-			executor.add_source_target_pair(sources[i], targets[i], rank[i]);
+		for (uint32_t i = 0; i < sources.size(); i++) {
+			cases.push_back({ i, sources[i], targets[i], rank[i] });
 		}
 	}
-	// Run
-	Timer timer;
-	while (!executor.is_done()) {
-		executor.run_iteration();
-		timer.lap();
-		std::vector<Path> paths = executor.extract_paths();
-		global_performance_logger.log_path_extraction_time(timer.get());
-		for (const Path& path : paths) {
-			if (log_quality) {
-				PathQualityResult pq = get_path_quality(g, ch, path, DEFAULT_ALPHA);
-				global_performance_logger.log_alt_path_quality(pq);
-			} else {
-				global_performance_logger.log_alt_path_quality({
-					path.length, // length
-					0.0,         // stretch
-					0.0,         // local optimality
-					0.0,         // uniformly bounded stretch
-					0.0          // sharing
-				});
+	// Streaming log: Skip finished cases, a writer thread moves results from the sink to the file
+	std::unique_ptr<ResultWriter> writer;
+	if (log_format == LogFormat::BINARY) {
+		writer.reset(new ColumnarResultWriter(output_path + logname + get_log_extension(log_format)));
+	} else if (log_format != LogFormat::JSON) {
+		StreamingResultWriter* streaming_writer = new StreamingResultWriter(output_path + logname + get_log_extension(log_format), log_format, resume);
+		writer.reset(streaming_writer);
+		std::vector<bool> is_finished(cases.size(), false);
+		for (const FinishedCase& c : streaming_writer->get_finished_cases()) {
+			if (c.index < cases.size() && cases[c.index].source == c.source && cases[c.index].target == c.target) {
+				is_finished[c.index] = true;
+			}
+		}
+		std::vector<STCase> open_cases;
+		for (const STCase& c : cases) {
+			if (!is_finished[c.index]) {
+				open_cases.push_back(c);
+			}
+		}
+		if (open_cases.size() != cases.size()) {
+			LOG(INFO) << "Skipping " << cases.size() - open_cases.size() << " finished cases\n";
+		}
+		cases.swap(open_cases);
+	}
+	std::atomic<bool> workers_done(false);
+	std::thread writer_thread;
+	if (writer) {
+		writer_thread = std::thread([&]() {
+			while (!workers_done.load()) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				for (const TestCaseResult& result : global_result_sink.drain()) {
+					writer->write(result);
+				}
+				writer->flush();
 			}
+		});
+	}
+	// Run. Every worker has its own services over the shared graph and CH and logs into its own
+	// thread_local logger, finished cases go to global_result_sink.
+	WorkStealingQueue work_queue(cases.size(), thread_count);
+	SearchStatsTable run_stats; // Sum of the workers, only with SEARCH_STATS
+	std::mutex run_stats_lock;
+	auto worker_function = [&](uint32_t worker) {
+		if constexpr (search_stats_enabled) {
+			global_search_stats.clear();
 		}
+		ApplicationService executor(g, ch, potential_mode, search_mode, cch_topology.get(), ch_first_path);
+		executor.set_params(alpha, eps, pen);
 		if (draw_images) {
-			executor.save_visualisation(output_path + std::to_string(executor.get_current_source()) + "." + std::to_string(executor.get_current_target()) + ".ppm");
+			executor.supply_coordinate_vectors(latitude_vector, longitude_vector);
+		}
+		PathQualityService path_quality_service(g, ch);
+		Timer timer;
+		PerfProbe probe;
+		for (uint32_t i = work_queue.pop(worker); i != invalid_id; i = work_queue.pop(worker)) {
+			executor.run_iteration(cases[i]);
+			timer.lap();
+			probe.lap();
+			std::vector<Path> paths = executor.extract_paths();
+			global_performance_logger.log_path_extraction_time(timer.get());
+			global_performance_logger.log_path_extraction_counts(probe.get());
+			for (const Path& path : paths) {
+				if (log_quality) {
+					PathQualityResult pq = path_quality_service.get_path_quality(path, DEFAULT_ALPHA);
+					global_performance_logger.log_alt_path_quality(pq);
+				} else {
+					global_performance_logger.log_alt_path_quality({
+						path.length, // length
+						0.0,         // stretch
+						0.0,         // local optimality
+						0.0,         // uniformly bounded stretch
+						0.0          // sharing
+					});
+				}
+			}
+			if (draw_images) {
+				executor.save_visualisation(output_path + std::to_string(executor.get_current_source()) + "." + std::to_string(executor.get_current_target()) + ".ppm");
+			}
+			executor.finish_iteration();
+		}
+		if constexpr (search_stats_enabled) {
+			std::lock_guard<std::mutex> guard(run_stats_lock);
+			run_stats.add(global_search_stats);
+		}
+	};
+	if (thread_count == 1) {
+		worker_function(0);
+	} else {
+		LOG(INFO) << "Running " << cases.size() << " cases on " << thread_count << " threads\n";
+		std::vector<std::thread> workers;
+		for (uint32_t i = 0; i < thread_count; i++) {
+			workers.emplace_back(worker_function, i);
+		}
+		for (std::thread& worker : workers) {
+			worker.join();
 		}
-		executor.finish_iteration();
+	}
+	if constexpr (search_stats_enabled) {
+		LOG(INFO) << "Search stats:\n" << run_stats.to_string();
 	}
 	// Save log file
-	write_file(output_path + logname + ".json", global_performance_logger.results_to_json_string());
+	if (writer) {
+		workers_done.store(true);
+		writer_thread.join();
+		for (const TestCaseResult& result : global_result_sink.drain()) {
+			writer->write(result);
+		}
+		writer->finish();
+	} else {
+		write_file(output_path + logname + ".json", global_result_sink.results_to_json_string());
+	}
 	return 0;
 }
 
@@ -272,7 +429,7 @@ int generate_vectors(int argn, char** argv) {
 	;
 	auto parse_result = options.parse(argn, argv);
 	// Load graph
-	Graph g = read_graph(parse_result["input"].as<std::string>());
+	StaticGraph g = read_graph(parse_result["input"].as<std::string>());
 	std::string output_path = parse_result["output"].as<std::string>();
 	if (output_path.back() != '/') {
 		output_path.push_back('/');
@@ -330,6 +487,54 @@ int generate_vectors(int argn, char** argv) {
 	return 0;
 }
 
+// Builds a CH with contract_parallel and writes it in the format of read_ch, so it only has to be
+// built once per graph.
+int build_ch_mode(int argn, char** argv) {
+	cxxopts::Options options("CH-Potentials-Penalty", "Calculates alternative routes on road network graphs using penalty method and contraction hierarchy potentials.");
+	options.add_options()
+		("i,input", "Path to input folder", cxxopts::value<std::string>())
+		("o,output", "Path to the CH folder. Default: ch/ in the input folder", cxxopts::value<std::string>())
+		("threads", "Number of contraction threads (default: 1, 0: all cores)", cxxopts::value<uint32_t>())
+		("hop-limit", "Maximum number of arcs of a witness path (default: unlimited)", cxxopts::value<uint32_t>())
+		("settle-limit", "Maximum number of settled nodes per witness search (default: unlimited)", cxxopts::value<uint32_t>())
+	;
+	auto parse_result = options.parse(argn, argv);
+	if (parse_result.count("input") == 0) {
+		LOG(ERROR) << "Need to specify an input folder.\n";
+		return 1;
+	}
+	std::string input_path = parse_result["input"].as<std::string>();
+	if (input_path.back() != '/') {
+		input_path.push_back('/');
+	}
+	std::string ch_path = input_path + "ch/";
+	if (parse_result.count("output") != 0) {
+		ch_path = parse_result["output"].as<std::string>();
+		if (ch_path.back() != '/') {
+			ch_path.push_back('/');
+		}
+	}
+	uint32_t thread_count = (parse_result.count("threads") != 0) ? parse_result["threads"].as<uint32_t>() : 1;
+	if (thread_count == 0) {
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+	}
+	WitnessLimits limits;
+	if (parse_result.count("hop-limit") != 0) {
+		limits.max_hops = parse_result["hop-limit"].as<uint32_t>();
+	}
+	if (parse_result.count("settle-limit") != 0) {
+		limits.max_settled = parse_result["settle-limit"].as<uint32_t>();
+	}
+	StaticGraph static_graph = read_graph(input_path, false, true);
+	Graph g(static_graph);
+	Timer timer;
+	timer.lap();
+	ContractionHierarchy ch = contract_parallel(g, thread_count, limits);
+	LOG(INFO) << "Contraction took " << timer.get() / 1000 << " ms, writing CH to " << ch_path << "\n";
+	write_ch(ch_path, ch, static_graph);
+	return 0;
+}
+
 int main(int argn, char** argv) {
 	AixLog::Log::init<AixLog::SinkCout>(AixLog::Severity::trace);
 	if (argn < 2) {
@@ -343,6 +548,8 @@ int main(int argn, char** argv) {
 		return_code = run_penalty_mode(argn, argv);
 	} else if (mode == "generate") {
 		return_code = generate_vectors(argn, argv);
+	} else if (mode == "contract") {
+		return_code = build_ch_mode(argn, argv);
 	} else {
 		LOG(ERROR) << "Unknown mode: " << mode << "\n";
 		return 1;
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "constants.h"
+#include "id_queue.h"
+#include "bit_util.h"
+#include <vector>
+#include <cstdint>
+#include <ctype.h>
+
+// Addressable multi-level bucket queue (Denardo/Fox, Cherkassky/Goldberg/Silverstein) for monotone
+// searches with integer keys. A key is split into digits of digit_bits bits. Relative to the last
+// popped key, a key goes to the level of its highest differing digit and there into the bucket of
+// that digit. Level 0 therefore works like a Dial bucket queue for keys close to the last popped
+// one, higher levels cover larger distances with the same number of buckets. Non-empty buckets are
+// tracked in a bitmap, so finding the next one only scans a few words.
+// Has the same interface as MinIDQueue, but peek may move elements and is therefore not const.
+template <uint32_t digit_bits = 8>
+class MultiLevelBucketQueue {
+
+	static_assert(digit_bits >= 1 && digit_bits <= 16, "Unsupported digit size");
+
+	private:
+		static constexpr uint32_t buckets_per_level = 1u << digit_bits;
+		static constexpr uint32_t level_count = (32 + digit_bits - 1) / digit_bits;
+		static constexpr uint32_t words_per_level = (buckets_per_level + 63) / 64;
+
+		std::vector<std::vector<IDKeyPair>> buckets;
+		std::vector<uint64_t> non_empty;
+		std::vector<uint32_t> bucket_of;
+		std::vector<uint32_t> pos;
+		uint32_t last = 0;
+		uint32_t n = 0;
+
+		static uint32_t get_digit(uint32_t key, uint32_t level) {
+			return (key >> (level * digit_bits)) & (buckets_per_level - 1);
+		}
+
+		uint32_t get_bucket(uint32_t key) const {
+			uint32_t diff = key ^ last;
+			uint32_t level = (diff == 0) ? 0 : highest_set_bit(diff) / digit_bits;
+			return level * buckets_per_level + get_digit(key, level);
+		}
+
+		void mark(uint32_t b) {
+			non_empty[b / 64] |= (uint64_t)1 << (b % 64);
+		}
+
+		void unmark(uint32_t b) {
+			non_empty[b / 64] &= ~((uint64_t)1 << (b % 64));
+		}
+
+		void insert(IDKeyPair p) {
+			uint32_t b = get_bucket(p.key);
+			bucket_of[p.id] = b;
+			pos[p.id] = buckets[b].size();
+			buckets[b].push_back(p);
+			mark(b);
+		}
+
+		void remove(uint32_t id) {
+			uint32_t b = bucket_of[id];
+			std::vector<IDKeyPair>& bucket = buckets[b];
+			IDKeyPair moved = bucket.back();
+			bucket[pos[id]] = moved;
+			pos[moved.id] = pos[id];
+			bucket.pop_back();
+			if (bucket.empty()) {
+				unmark(b);
+			}
+		}
+
+		// Returns the first non-empty bucket of the lowest non-empty level.
+		uint32_t find_first_bucket() const {
+			for (uint32_t w = 0; w < non_empty.size(); w++) {
+				if (non_empty[w] != 0) {
+					return w * 64 + lowest_set_bit(non_empty[w]);
+				}
+			}
+			return invalid_id;
+		}
+
+		// Makes sure that the first non-empty bucket is on level 0, so all its keys are minimal.
+		uint32_t refill() {
+			uint32_t b = find_first_bucket();
+			if (b < buckets_per_level) {
+				return b;
+			}
+			std::vector<IDKeyPair> moved;
+			moved.swap(buckets[b]);
+			unmark(b);
+			uint32_t min_key = moved[0].key;
+			for (const IDKeyPair& p : moved) {
+				if (p.key < min_key) {
+					min_key = p.key;
+				}
+			}
+			last = min_key;
+			for (const IDKeyPair& p : moved) {
+				insert(p);
+			}
+			moved.clear();
+			moved.swap(buckets[b]); // Keep the allocation
+			return get_bucket(last);
+		}
+
+	public:
+		typedef IDKeyPair PairT;
+
+		MultiLevelBucketQueue(uint32_t id_count) :
+			buckets(level_count * buckets_per_level),
+			non_empty(level_count * words_per_level, 0),
+			bucket_of(id_count, invalid_id),
+			pos(id_count, invalid_id)
+		{}
+
+		bool empty() const {
+			return n == 0;
+		}
+
+		uint32_t size() const {
+			return n;
+		}
+
+		bool contains_id(uint32_t id) const {
+			return bucket_of[id] != invalid_id;
+		}
+
+		uint32_t get_key(uint32_t id) const {
+			return buckets[bucket_of[id]][pos[id]].key;
+		}
+
+		IDKeyPair peek() {
+			return buckets[refill()].back();
+		}
+
+		void push(IDKeyPair p) {
+			insert(p);
+			n++;
+		}
+
+		IDKeyPair pop() {
+			uint32_t b = refill();
+			IDKeyPair ret = buckets[b].back();
+			buckets[b].pop_back();
+			if (buckets[b].empty()) {
+				unmark(b);
+			}
+			bucket_of[ret.id] = invalid_id;
+			last = ret.key;
+			n--;
+			return ret;
+		}
+
+		// The new key must not be larger than the old one.
+		void decrease_key(IDKeyPair p) {
+			remove(p.id);
+			insert(p);
+		}
+
+		void clear() {
+			for (uint32_t w = 0; w < non_empty.size(); w++) {
+				while (non_empty[w] != 0) {
+					uint32_t b = w * 64 + lowest_set_bit(non_empty[w]);
+					for (const IDKeyPair& p : buckets[b]) {
+						bucket_of[p.id] = invalid_id;
+					}
+					buckets[b].clear();
+					unmark(b);
+				}
+			}
+			last = 0;
+			n = 0;
+		}
+};
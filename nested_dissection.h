@@ -0,0 +1,185 @@
+#pragma once
+
+#include "static_graph.h"
+#include "constants.h"
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <ctype.h>
+
+// Metric-independent node order by recursive bisection, for CCHs. A connected subgraph is split by
+// one BFS level: all nodes of the level form the separator, which gets the highest ranks of the
+// subgraph, and the nodes before and after it are ordered recursively. Nodes of different parts
+// are never adjacent, so contracting in this order only adds fill-in inside a part and towards its
+// separators. The BFS starts at pseudo-peripheral nodes, of two candidates the smaller balanced
+// separator is taken. No coordinates are needed, weights are ignored.
+class NestedDissection {
+
+	private:
+		static const uint32_t leaf_size = 8; // Smaller parts are ordered arbitrarily
+		std::vector<uint32_t> first_out; // Undirected graph without loops and parallel arcs
+		std::vector<node_t> head;
+		std::vector<uint32_t> part; // Part a node belongs to, invalid_id once it has a rank
+		std::vector<uint32_t> level; // BFS level, only valid for the nodes of the current part
+		std::vector<node_t> bfs_queue;
+		std::vector<uint32_t> ranking;
+		uint32_t next_rank; // Ranks are handed out from the top
+		uint32_t part_count = 0;
+
+		// BFS from source within its part, fills level and bfs_queue (in BFS order)
+		void bfs(const std::vector<node_t>& nodes, node_t source) {
+			for (node_t n : nodes) {
+				level[n] = invalid_id;
+			}
+			bfs_queue.clear();
+			bfs_queue.push_back(source);
+			level[source] = 0;
+			for (uint32_t i = 0; i < bfs_queue.size(); i++) {
+				node_t u = bfs_queue[i];
+				for (uint32_t a = first_out[u]; a < first_out[u + 1]; a++) {
+					node_t v = head[a];
+					if (part[v] == part[u] && level[v] == invalid_id) {
+						level[v] = level[u] + 1;
+						bfs_queue.push_back(v);
+					}
+				}
+			}
+		}
+
+		// Smallest level whose removal leaves at least a quarter of the nodes on both sides, or the
+		// median level if there is none. Needs at least two levels. Returns (separator size, level).
+		std::pair<uint32_t, uint32_t> find_separator_level() const {
+			uint32_t n = bfs_queue.size();
+			uint32_t levels = level[bfs_queue.back()] + 1;
+			std::vector<uint32_t> count(levels, 0);
+			for (node_t u : bfs_queue) {
+				count[level[u]]++;
+			}
+			std::pair<uint32_t, uint32_t> best(invalid_id, invalid_id);
+			uint32_t median = invalid_id;
+			uint32_t before = 0;
+			for (uint32_t l = 0; l < levels; l++) {
+				uint32_t after = n - before - count[l];
+				if (median == invalid_id && before + count[l] >= n / 2) {
+					median = l;
+				}
+				if (4 * before >= n && 4 * after >= n && count[l] < best.first) {
+					best = std::make_pair(count[l], l);
+				}
+				before += count[l];
+			}
+			if (best.second != invalid_id) {
+				return best;
+			}
+			// The last level does not separate anything (e.g. the leaves of a star)
+			median = std::min(median, levels - 2);
+			return std::make_pair(count[median], median);
+		}
+
+		void assign_ranks(const std::vector<node_t>& nodes) {
+			for (node_t n : nodes) {
+				ranking[n] = --next_rank;
+				part[n] = invalid_id;
+			}
+		}
+
+		std::vector<node_t> new_part(std::vector<node_t> nodes) {
+			for (node_t n : nodes) {
+				part[n] = part_count;
+			}
+			part_count++;
+			return nodes;
+		}
+
+	public:
+		NestedDissection(const StaticGraph& g) :
+			first_out(g.size() + 1, 0),
+			part(g.size(), 0),
+			level(g.size(), invalid_id),
+			ranking(g.size(), invalid_id),
+			next_rank(g.size())
+		{
+			std::vector<std::vector<node_t>> neighbours(g.size());
+			for (node_t u = 0; u < g.size(); u++) {
+				for (const Edge& e : g.get_out_arcs(u)) {
+					if (e.target != u) {
+						neighbours[u].push_back(e.target);
+						neighbours[e.target].push_back(u);
+					}
+				}
+			}
+			for (node_t u = 0; u < g.size(); u++) {
+				std::sort(neighbours[u].begin(), neighbours[u].end());
+				neighbours[u].erase(std::unique(neighbours[u].begin(), neighbours[u].end()), neighbours[u].end());
+				head.insert(head.end(), neighbours[u].begin(), neighbours[u].end());
+				first_out[u + 1] = head.size();
+				std::vector<node_t>().swap(neighbours[u]);
+			}
+		}
+
+		// Returns the rank of every node
+		std::vector<uint32_t> compute_ranking() {
+			std::vector<node_t> all(part.size());
+			for (node_t n = 0; n < all.size(); n++) {
+				all[n] = n;
+			}
+			std::vector<std::vector<node_t>> parts;
+			parts.push_back(new_part(std::move(all)));
+			while (!parts.empty()) {
+				std::vector<node_t> nodes = std::move(parts.back());
+				parts.pop_back();
+				if (nodes.size() <= leaf_size) {
+					assign_ranks(nodes);
+					continue;
+				}
+				bfs(nodes, nodes[0]);
+				if (bfs_queue.size() < nodes.size()) {
+					// Not connected: split off the component of nodes[0], no separator is needed
+					std::vector<node_t> rest;
+					for (node_t n : nodes) {
+						if (level[n] == invalid_id) {
+							rest.push_back(n);
+						}
+					}
+					parts.push_back(new_part(bfs_queue));
+					parts.push_back(new_part(std::move(rest)));
+					continue;
+				}
+				// Two candidates: from the farthest node of the last BFS and from the farthest node of that one
+				node_t first_start = bfs_queue.back();
+				bfs(nodes, first_start);
+				std::pair<uint32_t, uint32_t> first_separator = find_separator_level();
+				node_t second_start = bfs_queue.back();
+				bfs(nodes, second_start);
+				std::pair<uint32_t, uint32_t> separator = find_separator_level();
+				if (first_separator.first < separator.first) {
+					separator = first_separator;
+					bfs(nodes, first_start);
+				}
+				uint32_t l = separator.second;
+				std::vector<node_t> below, separator_nodes, above;
+				for (node_t u : bfs_queue) {
+					if (level[u] < l) {
+						below.push_back(u);
+					} else if (level[u] > l) {
+						above.push_back(u);
+					} else {
+						// Separator nodes without a neighbour above only touch below and the separator
+						bool touches_above = false;
+						for (uint32_t a = first_out[u]; a < first_out[u + 1] && !touches_above; a++) {
+							touches_above = part[head[a]] == part[u] && level[head[a]] == l + 1;
+						}
+						(touches_above ? separator_nodes : below).push_back(u);
+					}
+				}
+				assign_ranks(separator_nodes);
+				parts.push_back(new_part(std::move(below)));
+				parts.push_back(new_part(std::move(above)));
+			}
+			return ranking;
+		}
+};
+
+std::vector<uint32_t> compute_nested_dissection_ranking(const StaticGraph& g) {
+	return NestedDissection(g).compute_ranking();
+}
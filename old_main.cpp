@@ -5,8 +5,8 @@
 #include "contraction.h"
 #include "potentials.h"
 #include "new_potentials.h"
-#include "base/vector_io.h"
-#include "base/constants.h"
+#include "vector_io.h"
+#include "constants.h"
 #include "visualisation.h"
 #include "penalty.h"
 #include "util.h"
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "graph.h"
+#include "static_graph.h"
+#include "constants.h"
+#include <vector>
+#include <ctype.h>
+
+// Arcs of one node with the penalty added to the base weight. Forward arcs of a node have
+// consecutive ids, so their penalties are read sequentially. Reverse arcs look up the id of the
+// corresponding forward arc (indirect).
+template <bool indirect>
+class PenalizedArcRange {
+
+	public:
+
+		class Iterator {
+
+			private:
+				const uint32_t* head;
+				const uint32_t* weight;
+				const uint32_t* delta;
+				const uint32_t* arc_id;
+
+			public:
+				Iterator(const uint32_t* head, const uint32_t* weight, const uint32_t* delta, const uint32_t* arc_id) : head(head), weight(weight), delta(delta), arc_id(arc_id) {}
+
+				Edge operator*() const {
+					return { *head, *weight + (indirect ? delta[*arc_id] : *delta) };
+				}
+
+				Iterator& operator++() {
+					head++;
+					weight++;
+					if (indirect) {
+						arc_id++;
+					} else {
+						delta++;
+					}
+					return *this;
+				}
+
+				bool operator==(const Iterator& other) const {
+					return head == other.head;
+				}
+
+				bool operator!=(const Iterator& other) const {
+					return head != other.head;
+				}
+		};
+
+	private:
+		const uint32_t* head;
+		const uint32_t* weight;
+		const uint32_t* delta;
+		const uint32_t* arc_id;
+		uint32_t n;
+
+	public:
+		PenalizedArcRange(const uint32_t* head, const uint32_t* weight, const uint32_t* delta, const uint32_t* arc_id, uint32_t n) : head(head), weight(weight), delta(delta), arc_id(arc_id), n(n) {}
+
+		Iterator begin() const {
+			return Iterator(head, weight, delta, arc_id);
+		}
+
+		Iterator end() const {
+			return Iterator(head + n, weight + n, indirect ? delta : delta + n, indirect ? arc_id + n : arc_id);
+		}
+
+		Edge operator[](uint32_t i) const {
+			return { head[i], weight[i] + (indirect ? delta[arc_id[i]] : delta[i]) };
+		}
+
+		uint32_t size() const {
+			return n;
+		}
+
+		bool empty() const {
+			return n == 0;
+		}
+};
+
+// Penalized weights on top of an immutable StaticGraph (which needs reverse arcs). Only the
+// difference to the base weight is stored, indexed by forward arc id. Changed arcs are recorded,
+// so reset is proportional to the number of penalized arcs instead of the number of arcs.
+class PenalizedGraph {
+
+	private:
+		const StaticGraph& g;
+		std::vector<uint32_t> delta;
+		std::vector<uint32_t> changed_arcs;
+
+	public:
+		PenalizedGraph(const StaticGraph& g) : g(g), delta(g.n_edges(), 0) {}
+
+		PenalizedArcRange<false> get_out_arcs(node_t n) const {
+			uint32_t begin = g.get_first_out()[n];
+			uint32_t end = g.get_first_out()[n + 1];
+			return PenalizedArcRange<false>(g.get_head().data() + begin, g.get_weight().data() + begin, delta.data() + begin, nullptr, end - begin);
+		}
+
+		PenalizedArcRange<true> get_rev_out_arcs(node_t n) const {
+			uint32_t begin = g.get_rev_first_out()[n];
+			uint32_t end = g.get_rev_first_out()[n + 1];
+			return PenalizedArcRange<true>(g.get_rev_head().data() + begin, g.get_rev_weight().data() + begin, delta.data(), g.get_rev_arc_id().data() + begin, end - begin);
+		}
+
+		uint32_t get_out_arc_id(node_t n, uint32_t i) const {
+			return g.get_out_arc_id(n, i);
+		}
+
+		uint32_t get_rev_out_arc_id(node_t n, uint32_t i) const {
+			return g.get_rev_out_arc_id(n, i);
+		}
+
+		uint32_t find_arc(node_t u, node_t v) const {
+			return g.find_arc(u, v);
+		}
+
+		uint32_t get_arc_weight(uint32_t arc) const {
+			return g.get_weight()[arc] + delta[arc];
+		}
+
+		// The new weight must not be smaller than the base weight.
+		void set_arc_weight(uint32_t arc, uint32_t new_weight) {
+			if (delta[arc] == 0) {
+				changed_arcs.push_back(arc);
+			}
+			delta[arc] = new_weight - g.get_weight()[arc];
+		}
+
+		void reset() {
+			for (uint32_t arc : changed_arcs) {
+				delta[arc] = 0;
+			}
+			changed_arcs.clear();
+		}
+
+		uint32_t size() const {
+			return g.size();
+		}
+
+		uint32_t n_edges() const {
+			return g.n_edges();
+		}
+
+		const StaticGraph& get_base_graph() const {
+			return g;
+		}
+};
@@ -2,16 +2,20 @@
 
 #include "graph.h"
 #include "astar.h"
+#include "penalized_graph.h"
+#include "cch.h"
+#include "contraction.h"
 #include "potentials.h"
 #include "new_potentials.h"
 #include "timer.h"
 #include "util.h"
 #include "performance_logger.h"
 #include "timestamp_vector.h"
-#include "base/id_queue.h"
-#include "base/constants.h"
+#include "id_queue.h"
+#include "constants.h"
 #include "boolset.h"
 #include <unordered_set>
+#include <memory>
 #include <cmath>
 
 class PenaltyService {
@@ -20,13 +24,15 @@ private:
 
 	const uint32_t max_iterations = 20;
 
-	const Graph& g;
-	Graph penalized_graph;
+	const StaticGraph& g;
+	PenalizedGraph penalized_graph;
 	Graph alt_graph;
-	DijkstraService alt_graph_dijkstra;
+	DijkstraService<Graph> alt_graph_dijkstra;
 	const ContractionHierarchy& ch;
+	std::unique_ptr<CustomizableCH> cch; // Only if potentials follow the penalized weights
+	std::unique_ptr<CHQueryService<>> ch_query; // Only if the first path is found with a CH query
 	node_t source, target;
-	BidirectionalAStarService astar;
+	BidirectionalAStarService<PenalizedGraph> astar;
 	uint32_t best_path_length;
 	BoolSet node_set;
 
@@ -42,61 +48,70 @@ private:
 	};
 
 	uint32_t get_real_path_length(const Path& path) {
+		if (path.length == inf_weight) {
+			return inf_weight;
+		}
 		uint32_t ret = 0;
-		for (int i = 0; i < path.nodes.size() - 1; i++) {
-			uint32_t w = g.get_edge_weight(path.nodes[i], path.nodes[i + 1]);
-			if (w == inf_weight) {
-				return inf_weight;
-			}
-			ret = ret + w;
+		for (uint32_t arc : path.edges) {
+			ret = ret + g.get_arc_weight(arc);
 		}
 		return ret;
 	}
 
 	Path get_shortest_path() {
-		Path path = astar.run(source, target);
-		if (path.length == inf_weight) {
-			return path;
+		return astar.run(source, target);
+	}
+
+	// The first search runs on unpenalized weights, so a CH query can replace the A*.
+	Path get_first_shortest_path() {
+		if (ch_query) {
+			return ch_query->query_path(source, target);
 		}
-		Path ret;
-		ret.nodes = path.nodes;
-		ret.length = path.length;
-		return ret;
+		return get_shortest_path();
 	}
 
 	void add_path_to_graph(const Path& path, Graph& g) {
-		for (int i = 0; i < path.nodes.size() - 1; i++) {
-			node_t a = path.nodes[i];
-			node_t b = path.nodes[i + 1];
-			g.add_edge(a, { b, this->g.get_edge_weight(a, b) });
+		for (int i = 0; i < path.edges.size(); i++) {
+			g.add_edge(path.nodes[i], { path.nodes[i + 1], this->g.get_arc_weight(path.edges[i]) });
+		}
+	}
+
+	void penalize_arc(uint32_t arc, uint32_t new_weight) {
+		penalized_graph.set_arc_weight(arc, new_weight);
+		if (cch) {
+			cch->set_input_weight(arc, new_weight);
+		}
+	}
+
+	// Hands the arcs changed by the last CCH update or reset to the potentials.
+	void update_potentials() {
+		for (uint32_t arc : cch->get_updated_arcs()) {
+			astar.update_potential_arc(cch->get_tail(arc), cch->get_local_index(arc), cch->get_up_weight(arc), cch->get_down_weight(arc));
 		}
 	}
 
 #ifdef PENALIZE_ALT_GRAPH
 	void apply_penalties() {
 		for (const auto& e : alt_graph.get_edges()) {
-			node_t u = e.first;
-			node_t v = e.second;
-			penalized_graph.change_edge_weight(u, v, penalized_graph.get_edge_weight(u, v) * (1 + penalty_factor));
+			uint32_t arc = penalized_graph.find_arc(e.first, e.second);
+			penalize_arc(arc, penalized_graph.get_arc_weight(arc) * (1 + penalty_factor));
 		}
 	}
 #else
 	void apply_penalties(const Path& path, uint32_t optimal_path_length) {
 		// Penalize path edges
-		for (uint32_t i = 0; i < path.nodes.size() - 1; i++) {
-			node_t u = path.nodes[i];
-			node_t v = path.nodes[i + 1];
-			penalized_graph.change_edge_weight(u, v, penalized_graph.get_edge_weight(u, v) * (1 + penalty_factor));
+		for (uint32_t arc : path.edges) {
+			penalize_arc(arc, penalized_graph.get_arc_weight(arc) * (1 + penalty_factor));
 		}
 		// Penalize rejoin edges (incoming)
 		uint32_t rejoin_penalty = alpha * std::sqrt(optimal_path_length);
 		for (uint32_t i = 0; i < path.nodes.size(); i++) {
 			node_t v = path.nodes[i];
-			auto& rev_out_arcs = penalized_graph.get_rev_out_arcs(v);
-			for (const auto& edge : rev_out_arcs) {
-				node_t u = edge.target;
-				if (i == 0 || u != path.nodes[i - 1]) {
-					penalized_graph.change_edge_weight(u, v, penalized_graph.get_edge_weight(u, v) + rejoin_penalty);
+			uint32_t in_degree = penalized_graph.get_rev_out_arcs(v).size();
+			for (uint32_t j = 0; j < in_degree; j++) {
+				uint32_t arc = penalized_graph.get_rev_out_arc_id(v, j);
+				if (i == 0 || arc != path.edges[i - 1]) {
+					penalize_arc(arc, penalized_graph.get_arc_weight(arc) + rejoin_penalty);
 				}
 			}
 		}
@@ -130,7 +145,7 @@ private:
 				if (path.nodes[i] != intersection[intersection_index]) {
 					in_detour = true;
 					detour_start = path.nodes[i - 1];
-					detour_dist = g.get_edge_weight(path.nodes[i - 1], path.nodes[i]);
+					detour_dist = g.get_arc_weight(path.edges[i - 1]);
 				} else {
 					intersection_index++;
 				}
@@ -138,11 +153,11 @@ private:
 			else {
 				if (path.nodes[i] == intersection[intersection_index]) {
 					in_detour = false;
-					detour_dist += g.get_edge_weight(path.nodes[i - 1], path.nodes[i]);
+					detour_dist += g.get_arc_weight(path.edges[i - 1]);
 					detour_end = path.nodes[i];
 					ret.push_back({ detour_start, detour_end, detour_dist });
 				} else {
-					detour_dist += g.get_edge_weight(path.nodes[i - 1], path.nodes[i]);
+					detour_dist += g.get_arc_weight(path.edges[i - 1]);
 				}
 			}
 		}
@@ -172,13 +187,20 @@ private:
 
 public:
 
-	PenaltyService(const Graph& g, const ContractionHierarchy& ch) : 
+	// With cch_topology (shared by all services), the potentials come from a CCH that is
+	// re-customized after every penalty step, so they are exact for the penalized weights. Only
+	// the metric is stored per service. With ch_first_path,
+	// the shortest path is found by a CH query with unpacked shortcuts instead of the A*; ch needs
+	// middle nodes then.
+	PenaltyService(const StaticGraph& g, const ContractionHierarchy& ch, PotentialMode potential_mode = PotentialMode::LAZY, BidirectionalMode search_mode = BidirectionalMode::PARALLEL, const CCHTopology* cch_topology = nullptr, bool ch_first_path = false) : 
 		g(g), 
 		penalized_graph(g), 
 		alt_graph(g.size()), 
 		alt_graph_dijkstra(alt_graph), 
 		ch(ch),
-		astar(penalized_graph, ch), 
+		cch(cch_topology ? new CustomizableCH(*cch_topology) : nullptr),
+		ch_query(ch_first_path ? new CHQueryService<>(g, ch) : nullptr),
+		astar(penalized_graph, cch ? cch->get_ch() : ch, potential_mode, search_mode), 
 		node_set(g.size()) 
 	{
 		source = invalid_id;
@@ -208,9 +230,12 @@ public:
 	void run() {
 		Timer timer;
 		Timer total_timer;
+		PerfProbe probe;
 		timer.lap();
-		Path original_path = get_shortest_path();
+		probe.lap();
+		Path original_path = get_first_shortest_path();
 		global_performance_logger.log_first_astar_time(timer.get());
+		global_performance_logger.log_first_astar_counts(probe.get());
 		global_performance_logger.log_shortest_path_length(original_path.length);
 		add_path_to_graph(original_path, alt_graph);
 		Path alt_path = original_path;
@@ -219,24 +244,34 @@ public:
 			global_performance_logger.begin_iteration();
 			timer.lap();
 			total_timer.lap();
+			probe.lap();
 			#ifdef PENALIZE_ALT_GRAPH
 				apply_penalties();
 			#else
 				apply_penalties(alt_path, original_path.length);
 			#endif
+			if (cch) {
+				cch->update();
+				update_potentials();
+			}
 			global_performance_logger.log_iteration_apply_penalty_time(timer.get());
+			global_performance_logger.log_iteration_apply_penalty_counts(probe.get());
 			timer.lap();
+			probe.lap();
 			alt_path = get_shortest_path();
 			#ifdef BREAK_ON_ORIGINAL
 				alt_path.length = get_real_path_length(alt_path);
 			#endif
 			global_performance_logger.log_iteration_astar_time(timer.get());
+			global_performance_logger.log_iteration_astar_counts(probe.get());
 			global_performance_logger.log_iteration_alt_path_length(alt_path.length);
 			timer.lap();
+			probe.lap();
 			if (is_feasible(alt_path, original_path)) {
 				add_path_to_graph(alt_path, alt_graph);
 			}
 			global_performance_logger.log_iteration_is_feasible_time(timer.get());
+			global_performance_logger.log_iteration_is_feasible_counts(probe.get());
 			iterations++;
 			global_performance_logger.log_iteration_total_runtime(total_timer.get());
 			global_performance_logger.end_iteration();
@@ -248,7 +283,11 @@ public:
 	}
 
 	void reset() {
-		penalized_graph = g;
+		penalized_graph.reset();
+		if (cch) {
+			cch->reset();
+			update_potentials();
+		}
 		alt_graph.clear_edges();
 		source = invalid_id;
 		target = invalid_id;
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <atomic>
+#include <aixlog.hpp>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+// Hardware counter values of one phase. valid is false if counters are disabled, could not be
+// opened or the cycle counter never got scheduled, a single event the CPU does not support stays 0.
+struct PerfCounts {
+	bool valid = false;
+	uint64_t cycles = 0;
+	uint64_t instructions = 0;
+	uint64_t l1d_misses = 0;
+	uint64_t llc_misses = 0;
+	uint64_t branch_misses = 0;
+
+	PerfCounts operator-(const PerfCounts& o) const {
+		return { valid && o.valid, cycles - o.cycles, instructions - o.instructions, l1d_misses - o.l1d_misses, llc_misses - o.llc_misses, branch_misses - o.branch_misses };
+	}
+
+	std::string to_json() const {
+		return "{\"cycles\": " + std::to_string(cycles) + ", \"instructions\": " + std::to_string(instructions)
+			+ ", \"l1d_misses\": " + std::to_string(l1d_misses) + ", \"llc_misses\": " + std::to_string(llc_misses)
+			+ ", \"branch_misses\": " + std::to_string(branch_misses) + "}";
+	}
+};
+
+// Set once at startup, before any thread reads counters.
+std::atomic<bool> perf_counters_enabled(false);
+
+// The counters of one thread, opened with perf_event_open on first use. Counters are inherited by
+// threads started afterwards (e.g. the searches of the parallel bidirectional A*), their counts are
+// added when they exit. Reading is one read() per event. If the kernel multiplexes the events, values
+// are extrapolated from the time they were actually counting.
+class PerfCounterSet {
+
+private:
+	static const int event_count = 5;
+	int fds[event_count];
+	bool opened = false;
+	bool available = false;
+
+#ifdef __linux__
+	static int open_event(uint32_t type, uint64_t config) {
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.inherit = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+#endif
+
+	void open() {
+		opened = true;
+#ifdef __linux__
+		uint64_t l1d_read_miss = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		fds[0] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+		fds[1] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+		fds[2] = open_event(PERF_TYPE_HW_CACHE, l1d_read_miss);
+		fds[3] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+		fds[4] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+		available = fds[0] >= 0;
+#endif
+		static std::atomic<bool> reported(false);
+		if (!available && !reported.exchange(true)) {
+			LOG(ERROR) << "Hardware performance counters are not available, counts are not logged\n";
+		}
+	}
+
+	// Sets *running to false if the event was never scheduled, the value is meaningless then.
+	uint64_t read_event(int i, bool* running = nullptr) const {
+		if (running) {
+			*running = false;
+		}
+#ifdef __linux__
+		struct { uint64_t value, time_enabled, time_running; } data;
+		if (fds[i] < 0 || ::read(fds[i], &data, sizeof(data)) != sizeof(data) || data.time_running == 0) {
+			return 0;
+		}
+		if (running) {
+			*running = true;
+		}
+		if (data.time_running < data.time_enabled) {
+			return (uint64_t)((long double)data.value * data.time_enabled / data.time_running);
+		}
+		return data.value;
+#else
+		return 0;
+#endif
+	}
+
+public:
+	PerfCounterSet() {
+		for (int i = 0; i < event_count; i++) {
+			fds[i] = -1;
+		}
+	}
+
+	~PerfCounterSet() {
+#ifdef __linux__
+		for (int i = 0; i < event_count; i++) {
+			if (fds[i] >= 0) {
+				close(fds[i]);
+			}
+		}
+#endif
+	}
+
+	PerfCounts read() {
+		if (!opened) {
+			open();
+		}
+		if (!available) {
+			return PerfCounts();
+		}
+		PerfCounts ret;
+		ret.cycles = read_event(0, &ret.valid);
+		ret.instructions = read_event(1);
+		ret.l1d_misses = read_event(2);
+		ret.llc_misses = read_event(3);
+		ret.branch_misses = read_event(4);
+		return ret;
+	}
+};
+
+thread_local PerfCounterSet thread_perf_counters;
+
+// Used like Timer: lap starts a phase, get returns the counts since then. Does nothing unless
+// perf_counters_enabled is set.
+class PerfProbe {
+
+private:
+	PerfCounts start;
+
+public:
+	void lap() {
+		if (perf_counters_enabled.load(std::memory_order_relaxed)) {
+			start = thread_perf_counters.read();
+		}
+	}
+
+	PerfCounts get() {
+		if (!perf_counters_enabled.load(std::memory_order_relaxed)) {
+			return PerfCounts();
+		}
+		return thread_perf_counters.read() - start;
+	}
+};
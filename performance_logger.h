@@ -1,206 +1,326 @@
 #pragma once
 
 #include "graph.h"
+#include "perf_counters.h"
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <utility>
 
-class PerformanceLogger {
+struct IterationData {
+	long apply_penalties_time = 0;
+	long astar_time = 0;
+	long is_feasible_time = 0;
+	long total_time = 0;
+	uint32_t alt_path_length = 0;
+	uint32_t search_space = 0;
+	// Hardware counters per phase, only valid with --perf-counters
+	PerfCounts apply_penalties_counts;
+	PerfCounts astar_counts;
+	PerfCounts is_feasible_counts;
+};
 
-private:
+struct TestCaseResult {
+	uint32_t index = 0; // Position in the input, results are written in this order
+	node_t source;
+	node_t target;
+	uint32_t dijkstra_rank;
+	uint32_t shortest_path_length;
+	std::vector<PathQualityResult> alt_path_qualities;
+	long first_astar_time = 0;
+	long path_extraction_time = 0;
+	long total_time;
+	std::vector<IterationData> iterations;
+	PerfCounts first_astar_counts;
+	PerfCounts path_extraction_counts;
+};
 
-	struct IterationData {
-		long apply_penalties_time = 0;
-		long astar_time = 0;
-		long is_feasible_time = 0;
-		long total_time = 0;
-		uint32_t alt_path_length = 0;
-		uint32_t search_space = 0;
-	};
+// Collects finished test cases from all threads. append is lock-free (push onto a linked list
+// with compare-and-set). drain can be called at any time, e.g. by a thread that streams the
+// results to disk. results_to_json_string is only allowed once all threads are done.
+class ResultSink {
 
-	struct TestCaseResult {
-		node_t source;
-		node_t target;
-		uint32_t dijkstra_rank;
-		uint32_t shortest_path_length;
-		std::vector<PathQualityResult> alt_path_qualities;
-		long first_astar_time = 0;
-		long path_extraction_time = 0;
-		long total_time;
-		std::vector<IterationData> iterations;
+private:
+	struct Node {
+		TestCaseResult result;
+		Node* next;
 	};
 
-	std::vector<TestCaseResult> test_case_results;
-	TestCaseResult* current_case = NULL;
-	IterationData* current_iteration = NULL;
+	std::atomic<Node*> head;
+
+	// Results in input order. Takes the results out of the sink.
+	std::vector<TestCaseResult> take_sorted_results() {
+		std::vector<TestCaseResult> results = drain();
+		std::stable_sort(results.begin(), results.end(), [](const TestCaseResult& a, const TestCaseResult& b) {
+			return a.index < b.index;
+		});
+		return results;
+	}
+
+public:
+	ResultSink() : head(NULL) {}
+
+	~ResultSink() {
+		take_sorted_results();
+	}
+
+	void append(TestCaseResult&& result) {
+		Node* node = new Node{ std::move(result), head.load(std::memory_order_relaxed) };
+		while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {}
+	}
+
+	// Takes all results appended so far out of the sink, in the order they were appended. May run
+	// concurrently with append.
+	std::vector<TestCaseResult> drain() {
+		std::vector<TestCaseResult> results;
+		Node* node = head.exchange(NULL, std::memory_order_acquire);
+		while (node != NULL) {
+			results.push_back(std::move(node->result));
+			Node* next = node->next;
+			delete node;
+			node = next;
+		}
+		std::reverse(results.begin(), results.end());
+		return results;
+	}
+
+	std::string results_to_json_string() {
+		std::vector<TestCaseResult> test_case_results = take_sorted_results();
+		std::string json = "{\n";
+		json += "  \"tests\": {\n";
+		json += "    \"cases\": [\n";
+		for (auto i = test_case_results.begin(); i < test_case_results.end(); i++) {
+			json += "      {\n";
+			json += "        \"source\": " + std::to_string(i->source) + ",\n";
+			json += "        \"target\": " + std::to_string(i->target) + ",\n";
+			json += "        \"rank\": " + std::to_string(i->dijkstra_rank) + ",\n";
+			json += "        \"shortest_length\": " + std::to_string(i->shortest_path_length) + ",\n";
+			json += "        \"alt_paths\": [\n";
+			for (int j = 0; j < i->alt_path_qualities.size(); j++) {
+				uint32_t length = i->alt_path_qualities[j].length;
+				float stretch = i->alt_path_qualities[j].stretch;
+				float sharing = i->alt_path_qualities[j].sharing;
+				float lo = i->alt_path_qualities[j].local_optimality;
+				float ubs = i->alt_path_qualities[j].uniformly_bounded_stretch;
+				json += "          {\n";
+				json += "            \"length\": " + std::to_string(length) + ",\n";
+				json += "            \"stretch\": " + std::to_string(stretch) + ",\n";
+				json += "            \"sharing\": " + std::to_string(sharing) + ",\n";
+				json += "            \"local_optimality\": " + std::to_string(lo) + ",\n";
+				json += "            \"uniformly_bounded_stretch\": " + std::to_string(ubs) + "\n";
+				json += "          }";
+				if (j < i->alt_path_qualities.size() - 1) {
+					json += ",\n";
+				} else {
+					json += "\n";
+				}
+			}
+			json += "        ],\n";
+			json += "        \"first_astar_time\": " + std::to_string(i->first_astar_time) + ",\n";
+			json += "        \"path_extraction_time\": " + std::to_string(i->path_extraction_time) + ",\n";
+			json += "        \"total_time\": " + std::to_string(i->total_time) + ",\n";
+			if (i->first_astar_counts.valid) {
+				json += "        \"first_astar_counters\": " + i->first_astar_counts.to_json() + ",\n";
+				json += "        \"path_extraction_counters\": " + i->path_extraction_counts.to_json() + ",\n";
+			}
+			json += "        \"iterations\": [\n";
+			for (int j = 0; j < i->iterations.size(); j++) {
+				json += "          { ";
+				json += "\"apply_penalties\": " + std::to_string(i->iterations[j].apply_penalties_time) + ", ";
+				json += "\"astar_time\": " + std::to_string(i->iterations[j].astar_time) + ", ";
+				json += "\"astar_search_space\": " + std::to_string(i->iterations[j].search_space) + ", ";
+				json += "\"is_feasible\": " + std::to_string(i->iterations[j].is_feasible_time) + ", ";
+				json += "\"alt_path_length\": " + std::to_string(i->iterations[j].alt_path_length) + ", ";
+				json += "\"total\": " + std::to_string(i->iterations[j].total_time);
+				if (i->iterations[j].astar_counts.valid) {
+					json += ", \"apply_penalties_counters\": " + i->iterations[j].apply_penalties_counts.to_json();
+					json += ", \"astar_counters\": " + i->iterations[j].astar_counts.to_json();
+					json += ", \"is_feasible_counters\": " + i->iterations[j].is_feasible_counts.to_json();
+				}
+				json += " }";
+				if (j != i->iterations.size() - 1) {
+					json += ", ";
+				}
+				json += "\n";
+			}
+			json += "        ]\n";
+			json += "      }";
+			if (i != test_case_results.end() - 1) {
+				json += ", ";
+			}
+			json += "\n";
+		}
+		json += "    ]\n";
+		json += "  }\n";
+		json += "}";
+		return json;
+	}
+};
+
+ResultSink global_result_sink;
+
+// Collects the measurements of the test case that is currently run by one thread. The case and
+// iteration being logged are kept by value, so there are no pointers into growing vectors.
+// finish_test_case hands the case over to global_result_sink.
+class PerformanceLogger {
+
+private:
+	TestCaseResult current_case;
+	IterationData current_iteration;
+	bool in_case = false;
+	bool in_iteration = false;
 
 
 public:
 
 	void begin_test_case() {
-		test_case_results.push_back(TestCaseResult());
-		current_case = &test_case_results.back();
+		current_case = TestCaseResult();
+		in_case = true;
 	}
 
 	void finish_test_case() {
-		current_case = NULL;
-		current_iteration = NULL;
+		if (in_case) {
+			global_result_sink.append(std::move(current_case));
+		}
+		in_case = false;
+		in_iteration = false;
 	}
 
 	void begin_iteration() {
-		if (current_case != NULL) {
-			IterationData d;
-			current_case->iterations.push_back(d);
-			current_iteration = &(current_case->iterations.back());
+		if (in_case) {
+			current_iteration = IterationData();
+			in_iteration = true;
 		}
 	}
 
 	void end_iteration() {
-		current_iteration = NULL;
+		if (in_iteration) {
+			current_case.iterations.push_back(current_iteration);
+		}
+		in_iteration = false;
+	}
+
+	void set_case_index(uint32_t index) {
+		if (in_case) {
+			current_case.index = index;
+		}
 	}
 
 	void set_source(node_t source) {
-		if (current_case != NULL) {
-			current_case->source = source;
+		if (in_case) {
+			current_case.source = source;
 		}
 	}
 
 	void set_target(node_t target) {
-		if (current_case != NULL) {
-			current_case->target = target;
+		if (in_case) {
+			current_case.target = target;
 		}
 	}
 
 	void set_dijkstra_rank(uint32_t rank) {
-		if (current_case != NULL) {
-			current_case->dijkstra_rank = rank;
+		if (in_case) {
+			current_case.dijkstra_rank = rank;
 		}
 	}
 
 	void log_first_astar_time(long t) {
-		if (current_case != NULL) {
-			current_case->first_astar_time = t;
+		if (in_case) {
+			current_case.first_astar_time = t;
 		}
 	}
 
 	void log_path_extraction_time(long t) {
-		if (current_case != NULL) {
-			current_case->path_extraction_time = t;
+		if (in_case) {
+			current_case.path_extraction_time = t;
 		}
 	}
 
 	void log_iteration_apply_penalty_time(long t) {
-		if (current_iteration != NULL) {
-			current_iteration->apply_penalties_time = t;
+		if (in_iteration) {
+			current_iteration.apply_penalties_time = t;
 		}
 	}
 
 	void log_iteration_astar_time(long t) {
-		if (current_iteration != NULL) {
-			current_iteration->astar_time = t;
+		if (in_iteration) {
+			current_iteration.astar_time = t;
 		}
 	}
 
 	void log_iteration_astar_search_space(uint32_t search_space) {
-		if (current_iteration != NULL) {
-			current_iteration->search_space = search_space;
+		if (in_iteration) {
+			current_iteration.search_space = search_space;
+		}
+	}
+
+	void log_first_astar_counts(const PerfCounts& counts) {
+		if (in_case) {
+			current_case.first_astar_counts = counts;
+		}
+	}
+
+	void log_path_extraction_counts(const PerfCounts& counts) {
+		if (in_case) {
+			current_case.path_extraction_counts = counts;
+		}
+	}
+
+	void log_iteration_apply_penalty_counts(const PerfCounts& counts) {
+		if (in_iteration) {
+			current_iteration.apply_penalties_counts = counts;
+		}
+	}
+
+	void log_iteration_astar_counts(const PerfCounts& counts) {
+		if (in_iteration) {
+			current_iteration.astar_counts = counts;
+		}
+	}
+
+	void log_iteration_is_feasible_counts(const PerfCounts& counts) {
+		if (in_iteration) {
+			current_iteration.is_feasible_counts = counts;
 		}
 	}
 
 	void log_iteration_is_feasible_time(long t) {
-		if (current_iteration != NULL) {
-			current_iteration->is_feasible_time = t;
+		if (in_iteration) {
+			current_iteration.is_feasible_time = t;
 		}
 	}
 
 	void log_iteration_alt_path_length(uint32_t length) {
-		if (current_iteration != NULL) {
-			current_iteration->alt_path_length = length;
+		if (in_iteration) {
+			current_iteration.alt_path_length = length;
 		}
 	}
 
 	void log_iteration_total_runtime(long t) {
-		if (current_iteration != NULL) {
-			current_iteration->total_time = t;
+		if (in_iteration) {
+			current_iteration.total_time = t;
 		}
 	}
 
 	void log_total_runtime(long t) {
-		if (current_case != NULL) {
-			current_case->total_time = t;
+		if (in_case) {
+			current_case.total_time = t;
 		}
 	}
 
 	void log_shortest_path_length(uint32_t l) {
-		if (current_case != NULL) {
-			current_case->shortest_path_length = l;
+		if (in_case) {
+			current_case.shortest_path_length = l;
 		}
 	}
 
 	void log_alt_path_quality(PathQualityResult pq) {
-		if (current_case != NULL) {
-			current_case->alt_path_qualities.push_back(pq);
-		}
-	}
-
-	std::string results_to_json_string() {
-		std::string json = "{\n";
-		json += "  \"tests\": {\n";
-		json += "    \"cases\": [\n";
-		for (auto i = test_case_results.begin(); i < test_case_results.end(); i++) {
-			json += "      {\n";
-			json += "        \"source\": " + std::to_string(i->source) + ",\n";
-			json += "        \"target\": " + std::to_string(i->target) + ",\n";
-			json += "        \"rank\": " + std::to_string(i->dijkstra_rank) + ",\n";
-			json += "        \"shortest_length\": " + std::to_string(i->shortest_path_length) + ",\n";
-			json += "        \"alt_paths\": [\n";
-			for (int j = 0; j < i->alt_path_qualities.size(); j++) {
-				uint32_t length = i->alt_path_qualities[j].length;
-				float stretch = i->alt_path_qualities[j].stretch;
-				float sharing = i->alt_path_qualities[j].sharing;
-				float lo = i->alt_path_qualities[j].local_optimality;
-				float ubs = i->alt_path_qualities[j].uniformly_bounded_stretch;
-				json += "          {\n";
-				json += "            \"length\": " + std::to_string(length) + ",\n";
-				json += "            \"stretch\": " + std::to_string(stretch) + ",\n";
-				json += "            \"sharing\": " + std::to_string(sharing) + ",\n";
-				json += "            \"local_optimality\": " + std::to_string(lo) + ",\n";
-				json += "            \"uniformly_bounded_stretch\": " + std::to_string(ubs) + "\n";
-				json += "          }";
-				if (j < i->alt_path_qualities.size() - 1) {
-					json += ",\n";
-				} else {
-					json += "\n";
-				}
-			}
-			json += "        ],\n";
-			json += "        \"first_astar_time\": " + std::to_string(i->first_astar_time) + ",\n";
-			json += "        \"path_extraction_time\": " + std::to_string(i->path_extraction_time) + ",\n";
-			json += "        \"total_time\": " + std::to_string(i->total_time) + ",\n";
-			json += "        \"iterations\": [\n";
-			for (int j = 0; j < i->iterations.size(); j++) {
-				json += "          { ";
-				json += "\"apply_penalties\": " + std::to_string(i->iterations[j].apply_penalties_time) + ", ";
-				json += "\"astar_time\": " + std::to_string(i->iterations[j].astar_time) + ", ";
-				json += "\"astar_search_space\": " + std::to_string(i->iterations[j].search_space) + ", ";
-				json += "\"is_feasible\": " + std::to_string(i->iterations[j].is_feasible_time) + ", ";
-				json += "\"alt_path_length\": " + std::to_string(i->iterations[j].alt_path_length) + ", ";
-				json += "\"total\": " + std::to_string(i->iterations[j].total_time) + " }";
-				if (j != i->iterations.size() - 1) {
-					json += ", ";
-				}
-				json += "\n";
-			}
-			json += "        ]\n";
-			json += "      }";
-			if (i != test_case_results.end() - 1) {
-				json += ", ";
-			}
-			json += "\n";
+		if (in_case) {
+			current_case.alt_path_qualities.push_back(pq);
 		}
-		json += "    ]\n";
-		json += "  }\n";
-		json += "}";
-		return json;
 	}
 };
 
-PerformanceLogger global_performance_logger = PerformanceLogger();
\ No newline at end of file
+// Every thread logs into its own instance.
+thread_local PerformanceLogger global_performance_logger = PerformanceLogger();
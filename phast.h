@@ -0,0 +1,84 @@
+#pragma once
+
+#include "graph.h"
+#include "static_graph.h"
+#include "constants.h"
+#include <vector>
+#include <ctype.h>
+
+// Upward graph of a contraction hierarchy, renumbered such that local indices increase with the rank.
+// Arcs always point to larger local indices, so a sweep from the highest to the lowest index sees
+// every head before its tail. Arc arrays are laid out in the same order, so the sweep is a
+// sequential scan (PHAST, Delling et al.).
+class RankedGraph {
+
+	private:
+		std::vector<uint32_t> first_out;
+		std::vector<uint32_t> head;
+		std::vector<uint32_t> weight;
+		std::vector<node_t> nodes;
+
+	public:
+		RankedGraph() : first_out(1, 0) {}
+
+		// nodes must be sorted by increasing rank and local_index[nodes[i]] == i. Arcs to nodes whose
+		// local index is invalid_id are dropped, so a subset of the nodes can be used as long as it is
+		// closed under upward arcs.
+		RankedGraph(const StaticGraph& upward_graph, const std::vector<node_t>& _nodes, const std::vector<uint32_t>& local_index) : nodes(_nodes) {
+			first_out.reserve(nodes.size() + 1);
+			first_out.push_back(0);
+			for (node_t n : nodes) {
+				for (const Edge& e : upward_graph.get_out_arcs(n)) {
+					if (local_index[e.target] != invalid_id) {
+						head.push_back(local_index[e.target]);
+						weight.push_back(e.weight);
+					}
+				}
+				first_out.push_back(head.size());
+			}
+		}
+
+		// Sets every distance to the minimum over the upward arcs. Distances of nodes that were not
+		// reached by the upward search must be inf_weight beforehand.
+		void sweep(std::vector<uint32_t>& dist) const {
+			for (uint32_t i = size(); i-- > 0;) {
+				uint32_t d = dist[i];
+				for (uint32_t a = first_out[i]; a < first_out[i + 1]; a++) {
+					uint32_t new_d = dist[head[a]] + weight[a];
+					d = new_d < d ? new_d : d;
+				}
+				dist[i] = d;
+			}
+		}
+
+		ArcRange get_out_arcs(uint32_t i) const {
+			return ArcRange(head.data() + first_out[i], weight.data() + first_out[i], first_out[i + 1] - first_out[i]);
+		}
+
+		// Changes the weight of the j-th arc of local node i. Arcs are only dropped for partial graphs,
+		// so on a full ranked graph j is the index among the upward arcs in the original graph.
+		void set_arc_weight(uint32_t i, uint32_t j, uint32_t new_weight) {
+			weight[first_out[i] + j] = new_weight;
+		}
+
+		node_t get_node(uint32_t local_index) const {
+			return nodes[local_index];
+		}
+
+		uint32_t size() const {
+			return nodes.size();
+		}
+
+		uint32_t n_edges() const {
+			return head.size();
+		}
+};
+
+// Ranked graph over all nodes, local index == rank.
+RankedGraph make_ranked_graph(const StaticGraph& upward_graph, const std::vector<uint32_t>& ranking) {
+	std::vector<node_t> order(ranking.size());
+	for (node_t n = 0; n < ranking.size(); n++) {
+		order[ranking[n]] = n;
+	}
+	return RankedGraph(upward_graph, order, ranking);
+}
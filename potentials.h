@@ -3,90 +3,230 @@
 #include "graph.h"
 #include "dijkstra.h"
 #include "contraction.h"
-#include "timestamp_vector.h"
-#include "base/constants.h"
+#include "radix_heap.h"
+#include "phast.h"
+#include "constants.h"
 #include <ctype.h>
-#include <mutex>
+#include <atomic>
+#include <memory>
+#include <algorithm>
 
 class HeuristicProvider {
 public:
 	virtual uint32_t operator()(node_t node) = 0;
 };
 
-class CHPotentialService : public HeuristicProvider {
+// LAZY computes potentials on demand from the upward search space of the target.
+// PHAST computes all potentials in set_target with a sweep over the nodes in rank order. This is more
+// work per target, but afterwards every potential is an array lookup.
+enum class PotentialMode { LAZY, PHAST };
+
+static constexpr uint32_t potential_not_computed = invalid_id;
+
+// Memo of lazily computed potentials for a single thread, reset through a dirty list.
+class PotentialCache {
 
 	private:
-		const Graph& forward_graph;
-		const Graph& backward_graph;
-		DijkstraService backward_search;
-		TimestampVector<uint32_t> potentials;
-		node_t target;
+		std::vector<uint32_t> values;
+		std::vector<uint32_t> dirty_list;
+
+	public:
+		PotentialCache(uint32_t size) : values(size, potential_not_computed) {}
+
+		uint32_t get(uint32_t i) const {
+			return values[i];
+		}
+
+		void set(uint32_t i, uint32_t value) {
+			values[i] = value;
+			dirty_list.push_back(i);
+		}
 
+		void clear() {
+			for (uint32_t i : dirty_list) {
+				values[i] = potential_not_computed;
+			}
+			dirty_list.clear();
+		}
+};
+
+// Memo of lazily computed potentials that can be shared by several threads without locks. Every
+// entry packs the timestamp of the current target (high half) and the value (low half) into one
+// word, so an entry is published with a single compare-and-set and clear only steps the timestamp.
+// Potentials do not depend on the thread computing them, so losing a race only wastes some work.
+class AtomicPotentialCache {
+
+	private:
+		std::unique_ptr<std::atomic<uint64_t>[]> words;
+		uint32_t size;
+		uint32_t t = 1;
 
 	public:
-		CHPotentialService(const ContractionHierarchy& ch) : forward_graph(ch.forward_graph), backward_graph(ch.backward_graph), backward_search(ch.backward_graph), potentials(ch.backward_graph.size(), inf_weight) {
-			target = invalid_id;
+		AtomicPotentialCache(uint32_t size) : words(new std::atomic<uint64_t>[size]), size(size) {
+			for (uint32_t i = 0; i < size; i++) {
+				words[i].store(0, std::memory_order_relaxed);
+			}
 		}
 
-		uint32_t get_potential(node_t node) {
-			if (!potentials.has(node)) {
-				potentials.set(node, backward_search.get_dist(node));
-				const std::vector<Edge>& up_arcs = forward_graph.get_out_arcs(node);
-				for (int i = 0; i < up_arcs.size(); i++) {
-					potentials.set(node, std::min(potentials.get(node), get_potential(up_arcs[i].target) + up_arcs[i].weight));
+		uint32_t get(uint32_t i) const {
+			uint64_t word = words[i].load(std::memory_order_acquire);
+			return (word >> 32) == t ? (uint32_t)word : potential_not_computed;
+		}
+
+		void set(uint32_t i, uint32_t value) {
+			uint64_t expected = words[i].load(std::memory_order_relaxed);
+			uint64_t desired = ((uint64_t)t << 32) | value;
+			while ((expected >> 32) != t) {
+				if (words[i].compare_exchange_weak(expected, desired, std::memory_order_release, std::memory_order_relaxed)) {
+					return;
+				}
+			}
+		}
+
+		// Must not run concurrently with get or set.
+		void clear() {
+			t++;
+			if (t == 0) { // Timestamp overflow, stale entries could become valid again
+				for (uint32_t i = 0; i < size; i++) {
+					words[i].store(0, std::memory_order_relaxed);
+				}
+				t = 1;
+			}
+		}
+};
+
+// Common implementation of both CH potentials. The search graph is searched completely from the
+// target, the potential of a node is then the minimum over its upward arcs in the sweep graph.
+// All per-node arrays are indexed by rank and the sweep graph is stored as RankedGraph, so arcs
+// are visited in rank order in both modes.
+// With AtomicPotentialCache, get_potential may be called from several threads at once. set_target
+// must not run concurrently with anything else.
+template <class CacheT>
+class UpwardPotentialService : public HeuristicProvider {
+
+	private:
+		const std::vector<uint32_t>& ranking;
+		DijkstraService<StaticGraph, RadixIDQueue> upward_search; // Full search, monotone keys
+		RankedGraph sweep_graph;
+		PotentialMode mode;
+		std::vector<uint32_t> upward_dist; // Distances of the upward search, inf_weight if not reached
+		CacheT cache; // LAZY only
+		std::vector<uint32_t> phast_dist; // PHAST only
+		node_t target = invalid_id;
+
+		// Evaluates the upward DAG below r with an explicit stack. A node is only finished once all
+		// heads of its upward arcs are.
+		uint32_t compute_potential(uint32_t r) {
+			static thread_local std::vector<uint32_t> stack;
+			stack.push_back(r);
+			while (!stack.empty()) {
+				uint32_t v = stack.back();
+				if (cache.get(v) != potential_not_computed) {
+					stack.pop_back();
+					continue;
+				}
+				bool ready = true;
+				for (const Edge& e : sweep_graph.get_out_arcs(v)) {
+					if (cache.get(e.target) == potential_not_computed) {
+						stack.push_back(e.target);
+						ready = false;
+					}
+				}
+				if (!ready) {
+					continue;
 				}
+				uint32_t d = upward_dist[v];
+				for (const Edge& e : sweep_graph.get_out_arcs(v)) {
+					uint32_t new_d = cache.get(e.target) + e.weight;
+					d = new_d < d ? new_d : d;
+				}
+				cache.set(v, d);
+				stack.pop_back();
+			}
+			return cache.get(r);
+		}
+
+	public:
+		UpwardPotentialService(const StaticGraph& search_graph, const StaticGraph& upward_graph, const std::vector<uint32_t>& ranking, PotentialMode mode) :
+			ranking(ranking),
+			upward_search(search_graph, StatsScope::CH_POTENTIAL),
+			sweep_graph(make_ranked_graph(upward_graph, ranking)),
+			mode(mode),
+			upward_dist(mode == PotentialMode::LAZY ? ranking.size() : 0, inf_weight),
+			cache(mode == PotentialMode::LAZY ? ranking.size() : 0),
+			phast_dist(mode == PotentialMode::PHAST ? ranking.size() : 0, inf_weight)
+		{}
+
+		uint32_t get_potential(node_t node) {
+			uint32_t r = ranking[node];
+			if (mode == PotentialMode::PHAST) {
+				count_potential(StatsScope::CH_POTENTIAL, false);
+				return phast_dist[r];
 			}
-			return potentials.get(node);
+			uint32_t pot = cache.get(r);
+			count_potential(StatsScope::CH_POTENTIAL, pot == potential_not_computed);
+			if (pot != potential_not_computed) {
+				return pot;
+			}
+			return compute_potential(r);
 		}
 
 		void set_target(node_t _target) {
-			backward_search.finish();
-			backward_search.set_source(_target);
-			backward_search.run_until_done();
-			potentials.step_time();
+			if (mode == PotentialMode::LAZY) {
+				for (node_t n : upward_search.get_search_space()) {
+					upward_dist[ranking[n]] = inf_weight;
+				}
+				cache.clear();
+			}
+			upward_search.finish();
+			upward_search.set_source(_target);
+			upward_search.run_until_done();
+			if (mode == PotentialMode::LAZY) {
+				for (node_t n : upward_search.get_search_space()) {
+					upward_dist[ranking[n]] = upward_search.get_dist(n);
+				}
+			} else {
+				std::fill(phast_dist.begin(), phast_dist.end(), inf_weight);
+				for (node_t n : upward_search.get_search_space()) {
+					phast_dist[ranking[n]] = upward_search.get_dist(n);
+				}
+				sweep_graph.sweep(phast_dist);
+			}
 			target = _target;
 		}
 
 		uint32_t operator()(node_t node) {
-			uint32_t ret = get_potential(node);
-			return ret;
+			return get_potential(node);
 		}
+
+		// Must be called for every arc of the upward graph whose weight changes (e.g. by CCH
+		// customization). Changes of the search graph are seen directly. Takes effect on the next
+		// set_target.
+		void set_upward_arc_weight(node_t tail, uint32_t i, uint32_t weight) {
+			sweep_graph.set_arc_weight(ranking[tail], i, weight);
+		}
+};
+
+// Potential towards the target: Distance from a node to the target.
+template <class CacheT>
+class BasicCHPotentialService : public UpwardPotentialService<CacheT> {
+
+	public:
+		BasicCHPotentialService(const ContractionHierarchy& ch, PotentialMode mode = PotentialMode::LAZY) :
+			UpwardPotentialService<CacheT>(ch.backward_graph, ch.forward_graph, ch.ranking, mode) {}
 };
 
-class ReverseCHPotentialService : public HeuristicProvider {
+// Potential towards the source of a backward search: Distance from the "target" to a node.
+template <class CacheT>
+class BasicReverseCHPotentialService : public UpwardPotentialService<CacheT> {
 
-private:
-	const ContractionHierarchy& ch;
-	DijkstraService forward_search;
-	TimestampVector<uint32_t> potentials;
-	node_t target;
+	public:
+		BasicReverseCHPotentialService(const ContractionHierarchy& ch, PotentialMode mode = PotentialMode::LAZY) :
+			UpwardPotentialService<CacheT>(ch.forward_graph, ch.backward_graph, ch.ranking, mode) {}
+};
 
-public:
-	ReverseCHPotentialService(const ContractionHierarchy& ch) : ch(ch), forward_search(ch.forward_graph), potentials(ch.backward_graph.size(), inf_weight) {
-		target = invalid_id;
-	}
-
-	uint32_t get_potential(node_t node) {
-		if (!potentials.has(node)) {
-			potentials.set(node, forward_search.get_dist(node));
-			const std::vector<Edge>& up_arcs = ch.backward_graph.get_out_arcs(node);
-			for (int i = 0; i < up_arcs.size(); i++) {
-				potentials.set(node, std::min(potentials.get(node), get_potential(up_arcs[i].target) + up_arcs[i].weight));
-			}
-		}
-		return potentials.get(node);
-	}
-
-	void set_target(node_t _target) {
-		forward_search.finish();
-		forward_search.set_source(_target);
-		forward_search.run_until_done();
-		potentials.step_time();
-		target = _target;
-	}
-
-	uint32_t operator()(node_t node) {
-		uint32_t ret = get_potential(node);
-		return ret;
-	}
-};
\ No newline at end of file
+typedef BasicCHPotentialService<PotentialCache> CHPotentialService;
+typedef BasicReverseCHPotentialService<PotentialCache> ReverseCHPotentialService;
+// Can be queried by several threads at once
+typedef BasicCHPotentialService<AtomicPotentialCache> SharedCHPotentialService;
+typedef BasicReverseCHPotentialService<AtomicPotentialCache> SharedReverseCHPotentialService;
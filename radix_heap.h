@@ -0,0 +1,127 @@
+#pragma once
+
+#include "constants.h"
+#include "id_queue.h"
+#include "bit_util.h"
+#include <vector>
+#include <cstdint>
+#include <ctype.h>
+
+// Addressable radix heap for monotone searches: Keys must be integers and no key smaller than the
+// last popped key may be pushed, which is true for Dijkstra with non-negative weights.
+// Bucket i > 0 holds the keys whose highest bit differing from the last popped key is bit i - 1,
+// bucket 0 holds keys equal to it. Has the same interface as MinIDQueue, but peek may move
+// elements between buckets and is therefore not const.
+class RadixIDQueue {
+
+	private:
+		static constexpr uint32_t bucket_count = 33;
+
+		std::vector<IDKeyPair> buckets[bucket_count];
+		std::vector<uint32_t> bucket_of;
+		std::vector<uint32_t> pos;
+		uint32_t last = 0;
+		uint32_t n = 0;
+
+		uint32_t get_bucket(uint32_t key) const {
+			uint32_t diff = key ^ last;
+			if (diff == 0) {
+				return 0;
+			}
+			return highest_set_bit(diff) + 1;
+		}
+
+		void insert(IDKeyPair p) {
+			uint32_t b = get_bucket(p.key);
+			bucket_of[p.id] = b;
+			pos[p.id] = buckets[b].size();
+			buckets[b].push_back(p);
+		}
+
+		void remove(uint32_t id) {
+			std::vector<IDKeyPair>& bucket = buckets[bucket_of[id]];
+			IDKeyPair moved = bucket.back();
+			bucket[pos[id]] = moved;
+			pos[moved.id] = pos[id];
+			bucket.pop_back();
+		}
+
+		// Makes sure that bucket 0 holds the smallest key.
+		void refill() {
+			if (!buckets[0].empty()) {
+				return;
+			}
+			uint32_t b = 1;
+			while (buckets[b].empty()) {
+				b++;
+			}
+			uint32_t min_key = buckets[b][0].key;
+			for (const IDKeyPair& p : buckets[b]) {
+				if (p.key < min_key) {
+					min_key = p.key;
+				}
+			}
+			last = min_key;
+			for (const IDKeyPair& p : buckets[b]) {
+				insert(p);
+			}
+			buckets[b].clear();
+		}
+
+	public:
+		typedef IDKeyPair PairT;
+
+		RadixIDQueue(uint32_t id_count) : bucket_of(id_count, invalid_id), pos(id_count, invalid_id) {}
+
+		bool empty() const {
+			return n == 0;
+		}
+
+		uint32_t size() const {
+			return n;
+		}
+
+		bool contains_id(uint32_t id) const {
+			return bucket_of[id] != invalid_id;
+		}
+
+		uint32_t get_key(uint32_t id) const {
+			return buckets[bucket_of[id]][pos[id]].key;
+		}
+
+		IDKeyPair peek() {
+			refill();
+			return buckets[0].back();
+		}
+
+		void push(IDKeyPair p) {
+			insert(p);
+			n++;
+		}
+
+		IDKeyPair pop() {
+			refill();
+			IDKeyPair ret = buckets[0].back();
+			buckets[0].pop_back();
+			bucket_of[ret.id] = invalid_id;
+			n--;
+			return ret;
+		}
+
+		// The new key must not be larger than the old one.
+		void decrease_key(IDKeyPair p) {
+			remove(p.id);
+			insert(p);
+		}
+
+		void clear() {
+			for (uint32_t b = 0; b < bucket_count; b++) {
+				for (const IDKeyPair& p : buckets[b]) {
+					bucket_of[p.id] = invalid_id;
+				}
+				buckets[b].clear();
+			}
+			last = 0;
+			n = 0;
+		}
+};
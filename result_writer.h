@@ -0,0 +1,363 @@
+#pragma once
+
+#include "graph.h"
+#include "performance_logger.h"
+#include "vector_io.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <stdexcept>
+#include <filesystem>
+#include <algorithm>
+#include <cstdint>
+#include <aixlog.hpp>
+
+// JSON writes one document with all cases at the end of the run. JSONL and CSV write one line per
+// case as soon as it is finished, so memory stays constant and a crashed run can be resumed.
+// BINARY writes a folder with one vector file per metric (see ColumnarResultWriter).
+enum class LogFormat { JSON, JSONL, CSV, BINARY };
+
+std::string get_log_extension(LogFormat format) {
+	switch (format) {
+		case LogFormat::JSONL: return ".jsonl";
+		case LogFormat::CSV: return ".csv";
+		case LogFormat::BINARY: return "/";
+		default: return ".json";
+	}
+}
+
+// Receives finished cases from the writer thread in run mode.
+class ResultWriter {
+public:
+	virtual ~ResultWriter() {}
+	virtual void write(const TestCaseResult& result) = 0;
+	// Called after every batch of cases
+	virtual void flush() = 0;
+	// Called once after the last case
+	virtual void finish() {
+		flush();
+	}
+};
+
+std::string case_to_jsonl(const TestCaseResult& c) {
+	std::string line = "{\"index\": " + std::to_string(c.index);
+	line += ", \"source\": " + std::to_string(c.source);
+	line += ", \"target\": " + std::to_string(c.target);
+	line += ", \"rank\": " + std::to_string(c.dijkstra_rank);
+	line += ", \"shortest_length\": " + std::to_string(c.shortest_path_length);
+	line += ", \"alt_paths\": [";
+	for (uint32_t j = 0; j < c.alt_path_qualities.size(); j++) {
+		const PathQualityResult& pq = c.alt_path_qualities[j];
+		line += (j == 0) ? "{" : ", {";
+		line += "\"length\": " + std::to_string(pq.length);
+		line += ", \"stretch\": " + std::to_string(pq.stretch);
+		line += ", \"sharing\": " + std::to_string(pq.sharing);
+		line += ", \"local_optimality\": " + std::to_string(pq.local_optimality);
+		line += ", \"uniformly_bounded_stretch\": " + std::to_string(pq.uniformly_bounded_stretch) + "}";
+	}
+	line += "], \"first_astar_time\": " + std::to_string(c.first_astar_time);
+	line += ", \"path_extraction_time\": " + std::to_string(c.path_extraction_time);
+	line += ", \"total_time\": " + std::to_string(c.total_time);
+	if (c.first_astar_counts.valid) {
+		line += ", \"first_astar_counters\": " + c.first_astar_counts.to_json();
+		line += ", \"path_extraction_counters\": " + c.path_extraction_counts.to_json();
+	}
+	line += ", \"iterations\": [";
+	for (uint32_t j = 0; j < c.iterations.size(); j++) {
+		const IterationData& it = c.iterations[j];
+		line += (j == 0) ? "{" : ", {";
+		line += "\"apply_penalties\": " + std::to_string(it.apply_penalties_time);
+		line += ", \"astar_time\": " + std::to_string(it.astar_time);
+		line += ", \"astar_search_space\": " + std::to_string(it.search_space);
+		line += ", \"is_feasible\": " + std::to_string(it.is_feasible_time);
+		line += ", \"alt_path_length\": " + std::to_string(it.alt_path_length);
+		line += ", \"total\": " + std::to_string(it.total_time);
+		if (it.astar_counts.valid) {
+			line += ", \"apply_penalties_counters\": " + it.apply_penalties_counts.to_json();
+			line += ", \"astar_counters\": " + it.astar_counts.to_json();
+			line += ", \"is_feasible_counters\": " + it.is_feasible_counts.to_json();
+		}
+		line += "}";
+	}
+	line += "]}\n";
+	return line;
+}
+
+const char* csv_header = "index,source,target,rank,shortest_length,first_astar_time,path_extraction_time,total_time,"
+	"alt_path_length,alt_path_stretch,alt_path_sharing,alt_path_local_optimality,alt_path_uniformly_bounded_stretch,"
+	"iteration_apply_penalties,iteration_astar_time,iteration_astar_search_space,iteration_is_feasible,iteration_alt_path_length,iteration_total\n";
+
+// Appends one CSV column with the given value of every element, separated by ';'.
+template <class T, class F>
+void append_csv_list(std::string& line, const std::vector<T>& elements, F get_value) {
+	line += ",";
+	for (uint32_t j = 0; j < elements.size(); j++) {
+		if (j > 0) {
+			line += ";";
+		}
+		line += std::to_string(get_value(elements[j]));
+	}
+}
+
+// One row per case. Alternative paths and iterations become one column per value, the entries of a
+// column are separated by ';'.
+std::string case_to_csv(const TestCaseResult& c) {
+	std::string line = std::to_string(c.index) + "," + std::to_string(c.source) + "," + std::to_string(c.target) + ",";
+	line += std::to_string(c.dijkstra_rank) + "," + std::to_string(c.shortest_path_length) + ",";
+	line += std::to_string(c.first_astar_time) + "," + std::to_string(c.path_extraction_time) + "," + std::to_string(c.total_time);
+	append_csv_list(line, c.alt_path_qualities, [](const PathQualityResult& pq) { return pq.length; });
+	append_csv_list(line, c.alt_path_qualities, [](const PathQualityResult& pq) { return pq.stretch; });
+	append_csv_list(line, c.alt_path_qualities, [](const PathQualityResult& pq) { return pq.sharing; });
+	append_csv_list(line, c.alt_path_qualities, [](const PathQualityResult& pq) { return pq.local_optimality; });
+	append_csv_list(line, c.alt_path_qualities, [](const PathQualityResult& pq) { return pq.uniformly_bounded_stretch; });
+	append_csv_list(line, c.iterations, [](const IterationData& it) { return it.apply_penalties_time; });
+	append_csv_list(line, c.iterations, [](const IterationData& it) { return it.astar_time; });
+	append_csv_list(line, c.iterations, [](const IterationData& it) { return it.search_space; });
+	append_csv_list(line, c.iterations, [](const IterationData& it) { return it.is_feasible_time; });
+	append_csv_list(line, c.iterations, [](const IterationData& it) { return it.alt_path_length; });
+	append_csv_list(line, c.iterations, [](const IterationData& it) { return it.total_time; });
+	return line + "\n";
+}
+
+struct FinishedCase {
+	uint32_t index;
+	node_t source;
+	node_t target;
+};
+
+// Writes finished cases line by line as JSONL or CSV. Lines are collected in a buffer and written
+// in blocks, flush pushes everything to the file. With resume, an existing file is continued:
+// a line that was cut off by a crash is removed and the cases in the file can be skipped.
+class StreamingResultWriter : public ResultWriter {
+
+private:
+	static const uint32_t buffer_size = 1 << 16;
+
+	std::string path;
+	LogFormat format;
+	std::ofstream file;
+	std::string buffer;
+	std::vector<FinishedCase> finished_cases;
+
+	// Reads the complete lines of an existing file and cuts off the rest.
+	void read_existing_file() {
+		std::ifstream in(path, std::ios::binary);
+		if (!in) {
+			return;
+		}
+		std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		in.close();
+		size_t complete = content.rfind('\n');
+		complete = (complete == std::string::npos) ? 0 : complete + 1;
+		size_t pos = 0;
+		while (pos < complete) {
+			size_t end = content.find('\n', pos);
+			std::string line = content.substr(pos, end - pos);
+			pos = end + 1;
+			FinishedCase c;
+			int read = (format == LogFormat::CSV)
+				? std::sscanf(line.c_str(), "%u,%u,%u", &c.index, &c.source, &c.target)
+				: std::sscanf(line.c_str(), "{\"index\": %u, \"source\": %u, \"target\": %u", &c.index, &c.source, &c.target);
+			if (read == 3) {
+				finished_cases.push_back(c);
+			}
+		}
+		if (complete != content.size()) {
+			LOG(INFO) << "Removing incomplete last line of " << path << "\n";
+			std::ofstream out(path, std::ios::binary | std::ios::trunc);
+			out.write(content.data(), complete);
+		}
+	}
+
+public:
+	StreamingResultWriter(const std::string& path, LogFormat format, bool resume) : path(path), format(format) {
+		if (resume) {
+			read_existing_file();
+		}
+		bool has_header = !finished_cases.empty() || (resume && std::ifstream(path).peek() != std::ifstream::traits_type::eof());
+		file.open(path, std::ios::binary | (resume ? std::ios::app : std::ios::trunc));
+		if (!file) {
+			throw std::runtime_error("Can't open " + path + " for writing");
+		}
+		if (format == LogFormat::CSV && !has_header) {
+			buffer += csv_header;
+		}
+		LOG(INFO) << "Writing results to " << path << ((resume) ? ", " + std::to_string(finished_cases.size()) + " cases already done" : "") << "\n";
+	}
+
+	~StreamingResultWriter() {
+		flush();
+	}
+
+	// Cases found in the file when resuming.
+	const std::vector<FinishedCase>& get_finished_cases() const {
+		return finished_cases;
+	}
+
+	void write(const TestCaseResult& result) {
+		buffer += (format == LogFormat::CSV) ? case_to_csv(result) : case_to_jsonl(result);
+		if (buffer.size() >= buffer_size) {
+			file.write(buffer.data(), buffer.size());
+			buffer.clear();
+		}
+	}
+
+	void flush() {
+		file.write(buffer.data(), buffer.size());
+		buffer.clear();
+		file.flush();
+	}
+};
+
+// Writes the results in columns, in the vector format of the graph files: One file per metric
+// with one entry per case (in input order), and one file per metric of the iterations and
+// alternative paths. The entries of case i are at [iteration_first_out[i], iteration_first_out[i + 1])
+// and [alt_path_first_out[i], alt_path_first_out[i + 1]). Times are int64_t, stretch and
+// sharing values float, everything else uint32_t.
+// Values are appended to the columns while running, finish only reorders them and writes each
+// column with a single write.
+class ColumnarResultWriter : public ResultWriter {
+
+private:
+	std::string path;
+	// Per case
+	std::vector<uint32_t> index, source, target, rank, shortest_length;
+	std::vector<int64_t> first_astar_time, path_extraction_time, total_time;
+	std::vector<uint32_t> iteration_first_out, alt_path_first_out;
+	// Per iteration
+	std::vector<int64_t> iteration_apply_penalties, iteration_astar_time, iteration_is_feasible, iteration_total;
+	std::vector<uint32_t> iteration_astar_search_space, iteration_alt_path_length;
+	// Hardware counters, only written if they were recorded
+	bool has_counts = false;
+	std::vector<PerfCounts> first_astar_counts, path_extraction_counts;
+	std::vector<PerfCounts> iteration_apply_penalties_counts, iteration_astar_counts, iteration_is_feasible_counts;
+	// Per alternative path
+	std::vector<uint32_t> alt_path_length;
+	std::vector<float> alt_path_stretch, alt_path_sharing, alt_path_local_optimality, alt_path_uniformly_bounded_stretch;
+
+	template <class T>
+	static std::vector<T> permute(const std::vector<T>& vec, const std::vector<uint32_t>& order) {
+		std::vector<T> ret(order.size());
+		for (uint32_t i = 0; i < order.size(); i++) {
+			ret[i] = vec[order[i]];
+		}
+		return ret;
+	}
+
+	// Reorders the ranges of a per-iteration or per-path column like the cases
+	template <class T>
+	static std::vector<T> permute_ranges(const std::vector<T>& vec, const std::vector<uint32_t>& first_out, const std::vector<uint32_t>& order) {
+		std::vector<T> ret;
+		ret.reserve(vec.size());
+		for (uint32_t i : order) {
+			ret.insert(ret.end(), vec.begin() + first_out[i], vec.begin() + first_out[i + 1]);
+		}
+		return ret;
+	}
+
+	// One uint64_t file per counter, e.g. astar_counts_cycles
+	void save_counts(const std::string& name, const std::vector<PerfCounts>& counts) {
+		std::vector<uint64_t> values(counts.size());
+		auto save = [&](const std::string& counter, uint64_t PerfCounts::*member) {
+			for (uint32_t i = 0; i < counts.size(); i++) {
+				values[i] = counts[i].*member;
+			}
+			save_vector(path + name + "_" + counter, values);
+		};
+		save("cycles", &PerfCounts::cycles);
+		save("instructions", &PerfCounts::instructions);
+		save("l1d_misses", &PerfCounts::l1d_misses);
+		save("llc_misses", &PerfCounts::llc_misses);
+		save("branch_misses", &PerfCounts::branch_misses);
+	}
+
+	static std::vector<uint32_t> permute_first_out(const std::vector<uint32_t>& first_out, const std::vector<uint32_t>& order) {
+		std::vector<uint32_t> ret(1, 0);
+		ret.reserve(first_out.size());
+		for (uint32_t i : order) {
+			ret.push_back(ret.back() + first_out[i + 1] - first_out[i]);
+		}
+		return ret;
+	}
+
+public:
+	ColumnarResultWriter(const std::string& path) : path(path), iteration_first_out(1, 0), alt_path_first_out(1, 0) {
+		std::filesystem::create_directories(path);
+		LOG(INFO) << "Writing results to " << path << "\n";
+	}
+
+	void write(const TestCaseResult& c) {
+		index.push_back(c.index);
+		source.push_back(c.source);
+		target.push_back(c.target);
+		rank.push_back(c.dijkstra_rank);
+		shortest_length.push_back(c.shortest_path_length);
+		first_astar_time.push_back(c.first_astar_time);
+		path_extraction_time.push_back(c.path_extraction_time);
+		total_time.push_back(c.total_time);
+		has_counts |= c.first_astar_counts.valid;
+		first_astar_counts.push_back(c.first_astar_counts);
+		path_extraction_counts.push_back(c.path_extraction_counts);
+		for (const IterationData& it : c.iterations) {
+			iteration_apply_penalties_counts.push_back(it.apply_penalties_counts);
+			iteration_astar_counts.push_back(it.astar_counts);
+			iteration_is_feasible_counts.push_back(it.is_feasible_counts);
+			iteration_apply_penalties.push_back(it.apply_penalties_time);
+			iteration_astar_time.push_back(it.astar_time);
+			iteration_astar_search_space.push_back(it.search_space);
+			iteration_is_feasible.push_back(it.is_feasible_time);
+			iteration_alt_path_length.push_back(it.alt_path_length);
+			iteration_total.push_back(it.total_time);
+		}
+		iteration_first_out.push_back(iteration_astar_time.size());
+		for (const PathQualityResult& pq : c.alt_path_qualities) {
+			alt_path_length.push_back(pq.length);
+			alt_path_stretch.push_back(pq.stretch);
+			alt_path_sharing.push_back(pq.sharing);
+			alt_path_local_optimality.push_back(pq.local_optimality);
+			alt_path_uniformly_bounded_stretch.push_back(pq.uniformly_bounded_stretch);
+		}
+		alt_path_first_out.push_back(alt_path_length.size());
+	}
+
+	void flush() {}
+
+	void finish() {
+		std::vector<uint32_t> order(index.size());
+		for (uint32_t i = 0; i < order.size(); i++) {
+			order[i] = i;
+		}
+		std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+			return index[a] < index[b];
+		});
+		save_vector(path + "index", permute(index, order));
+		save_vector(path + "source", permute(source, order));
+		save_vector(path + "target", permute(target, order));
+		save_vector(path + "rank", permute(rank, order));
+		save_vector(path + "shortest_length", permute(shortest_length, order));
+		save_vector(path + "first_astar_time", permute(first_astar_time, order));
+		save_vector(path + "path_extraction_time", permute(path_extraction_time, order));
+		save_vector(path + "total_time", permute(total_time, order));
+		save_vector(path + "iteration_first_out", permute_first_out(iteration_first_out, order));
+		save_vector(path + "iteration_apply_penalties", permute_ranges(iteration_apply_penalties, iteration_first_out, order));
+		save_vector(path + "iteration_astar_time", permute_ranges(iteration_astar_time, iteration_first_out, order));
+		save_vector(path + "iteration_astar_search_space", permute_ranges(iteration_astar_search_space, iteration_first_out, order));
+		save_vector(path + "iteration_is_feasible", permute_ranges(iteration_is_feasible, iteration_first_out, order));
+		save_vector(path + "iteration_alt_path_length", permute_ranges(iteration_alt_path_length, iteration_first_out, order));
+		save_vector(path + "iteration_total", permute_ranges(iteration_total, iteration_first_out, order));
+		save_vector(path + "alt_path_first_out", permute_first_out(alt_path_first_out, order));
+		save_vector(path + "alt_path_length", permute_ranges(alt_path_length, alt_path_first_out, order));
+		save_vector(path + "alt_path_stretch", permute_ranges(alt_path_stretch, alt_path_first_out, order));
+		save_vector(path + "alt_path_sharing", permute_ranges(alt_path_sharing, alt_path_first_out, order));
+		save_vector(path + "alt_path_local_optimality", permute_ranges(alt_path_local_optimality, alt_path_first_out, order));
+		save_vector(path + "alt_path_uniformly_bounded_stretch", permute_ranges(alt_path_uniformly_bounded_stretch, alt_path_first_out, order));
+		if (has_counts) {
+			save_counts("first_astar_counts", permute(first_astar_counts, order));
+			save_counts("path_extraction_counts", permute(path_extraction_counts, order));
+			save_counts("iteration_apply_penalties_counts", permute_ranges(iteration_apply_penalties_counts, iteration_first_out, order));
+			save_counts("iteration_astar_counts", permute_ranges(iteration_astar_counts, iteration_first_out, order));
+			save_counts("iteration_is_feasible_counts", permute_ranges(iteration_is_feasible_counts, iteration_first_out, order));
+		}
+	}
+};
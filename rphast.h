@@ -0,0 +1,89 @@
+#pragma once
+
+#include "graph.h"
+#include "static_graph.h"
+#include "dijkstra.h"
+#include "contraction.h"
+#include "radix_heap.h"
+#include "phast.h"
+#include "constants.h"
+#include <vector>
+#include <algorithm>
+#include <ctype.h>
+
+// Restricted PHAST (Delling et al.) for batched distance queries: select_sources extracts the part of
+// the upward graph reachable from a set of source nodes once. Afterwards, run computes the distances
+// from all selected sources to a target by sweeping only that part instead of the whole graph.
+class RPHASTService {
+
+private:
+	const ContractionHierarchy& ch;
+	DijkstraService<StaticGraph, RadixIDQueue> target_search;
+	std::vector<uint32_t> local_index;
+	std::vector<node_t> selection;
+	RankedGraph selection_graph;
+	std::vector<uint32_t> dist; // Indexed by local index
+	node_t target = invalid_id;
+
+public:
+	RPHASTService(const ContractionHierarchy& ch) : ch(ch), target_search(ch.backward_graph), local_index(ch.forward_graph.size(), invalid_id) {}
+
+	void select_sources(const std::vector<node_t>& sources) {
+		for (node_t n : selection) {
+			local_index[n] = invalid_id;
+		}
+		selection.clear();
+		// Collect all nodes reachable over upward arcs, local_index is used as visited marker
+		for (node_t s : sources) {
+			if (local_index[s] == invalid_id) {
+				local_index[s] = 0;
+				selection.push_back(s);
+			}
+		}
+		for (uint32_t i = 0; i < selection.size(); i++) {
+			for (const Edge& e : ch.forward_graph.get_out_arcs(selection[i])) {
+				if (local_index[e.target] == invalid_id) {
+					local_index[e.target] = 0;
+					selection.push_back(e.target);
+				}
+			}
+		}
+		std::sort(selection.begin(), selection.end(), [this](node_t a, node_t b) {
+			return ch.ranking[a] < ch.ranking[b];
+		});
+		for (uint32_t i = 0; i < selection.size(); i++) {
+			local_index[selection[i]] = i;
+		}
+		selection_graph = RankedGraph(ch.forward_graph, selection, local_index);
+		dist = std::vector<uint32_t>(selection.size(), inf_weight);
+		target = invalid_id;
+	}
+
+	// Computes the distances from all selected sources (and the nodes above them) to the target.
+	void run(node_t _target) {
+		target_search.finish();
+		target_search.set_source(_target);
+		target_search.run_until_done();
+		std::fill(dist.begin(), dist.end(), inf_weight);
+		for (node_t n : target_search.get_search_space()) {
+			if (local_index[n] != invalid_id) {
+				dist[local_index[n]] = target_search.get_dist(n);
+			}
+		}
+		selection_graph.sweep(dist);
+		target = _target;
+	}
+
+	// n must be one of the selected sources.
+	uint32_t get_dist(node_t n) const {
+		return dist[local_index[n]];
+	}
+
+	bool is_selected(node_t n) const {
+		return local_index[n] != invalid_id;
+	}
+
+	uint32_t selection_size() const {
+		return selection.size();
+	}
+};
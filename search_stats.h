@@ -0,0 +1,112 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// Operation counters of the search engines. They are only compiled in with -DSEARCH_STATS,
+// otherwise every count_* call is an empty inline function and nothing is stored.
+#ifdef SEARCH_STATS
+constexpr bool search_stats_enabled = true;
+#else
+constexpr bool search_stats_enabled = false;
+#endif
+
+// Which engine an operation belongs to. A DijkstraService is counted as the engine it is used by,
+// e.g. the upward searches of the CH potentials as CH_POTENTIAL.
+enum class StatsScope { DIJKSTRA, WITNESS, CH_QUERY, CH_POTENTIAL, ASTAR, BIDIRECTIONAL_ASTAR, XBDV, COUNT };
+
+const char* stats_scope_names[] = { "dijkstra", "witness", "ch_query", "ch_potential", "astar", "bidirectional_astar", "xbdv" };
+
+struct SearchStats {
+	uint64_t settled_nodes = 0;
+	uint64_t relaxed_arcs = 0;
+	uint64_t queue_pushes = 0;
+	uint64_t decrease_keys = 0;
+	uint64_t potential_evaluations = 0;
+	uint64_t potential_cache_misses = 0;
+
+	void add(const SearchStats& other) {
+		settled_nodes += other.settled_nodes;
+		relaxed_arcs += other.relaxed_arcs;
+		queue_pushes += other.queue_pushes;
+		decrease_keys += other.decrease_keys;
+		potential_evaluations += other.potential_evaluations;
+		potential_cache_misses += other.potential_cache_misses;
+	}
+
+	bool empty() const {
+		return settled_nodes == 0 && relaxed_arcs == 0 && potential_evaluations == 0;
+	}
+};
+
+// Counters of all engines
+struct SearchStatsTable {
+	SearchStats scopes[(int)StatsScope::COUNT];
+
+	SearchStats& operator[](StatsScope scope) {
+		return scopes[(int)scope];
+	}
+
+	void add(const SearchStatsTable& other) {
+		for (int i = 0; i < (int)StatsScope::COUNT; i++) {
+			scopes[i].add(other.scopes[i]);
+		}
+	}
+
+	void clear() {
+		*this = SearchStatsTable();
+	}
+
+	// One line per engine that did any work
+	std::string to_string() const {
+		std::string ret;
+		for (int i = 0; i < (int)StatsScope::COUNT; i++) {
+			const SearchStats& s = scopes[i];
+			if (s.empty()) {
+				continue;
+			}
+			ret += std::string(stats_scope_names[i]) + ": settled = " + std::to_string(s.settled_nodes);
+			ret += ", relaxed = " + std::to_string(s.relaxed_arcs);
+			ret += ", pushes = " + std::to_string(s.queue_pushes);
+			ret += ", decrease_keys = " + std::to_string(s.decrease_keys);
+			ret += ", potentials = " + std::to_string(s.potential_evaluations);
+			ret += ", potential_misses = " + std::to_string(s.potential_cache_misses) + "\n";
+		}
+		return ret;
+	}
+};
+
+// Every thread counts into its own table. Threads that only live for part of a query (e.g. the
+// searches of the parallel bidirectional A*) must hand their counts to the calling thread.
+thread_local SearchStatsTable global_search_stats;
+
+inline void count_settled(StatsScope scope) {
+	if constexpr (search_stats_enabled) {
+		global_search_stats[scope].settled_nodes++;
+	}
+}
+
+inline void count_relaxed(StatsScope scope, uint64_t arcs) {
+	if constexpr (search_stats_enabled) {
+		global_search_stats[scope].relaxed_arcs += arcs;
+	}
+}
+
+inline void count_push(StatsScope scope) {
+	if constexpr (search_stats_enabled) {
+		global_search_stats[scope].queue_pushes++;
+	}
+}
+
+inline void count_decrease_key(StatsScope scope) {
+	if constexpr (search_stats_enabled) {
+		global_search_stats[scope].decrease_keys++;
+	}
+}
+
+inline void count_potential(StatsScope scope, bool cache_miss) {
+	if constexpr (search_stats_enabled) {
+		global_search_stats[scope].potential_evaluations++;
+		global_search_stats[scope].potential_cache_misses += cache_miss;
+	}
+}
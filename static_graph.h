@@ -0,0 +1,342 @@
+#pragma once
+
+#include "graph.h"
+#include "vector_io.h"
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <ctype.h>
+#include "constants.h"
+
+// View on the outgoing arcs of a single node in a StaticGraph. Arcs are
+// handed out as Edge values, so loops written against Graph also work here.
+class ArcRange {
+
+	public:
+
+		class Iterator {
+
+			private:
+				const uint32_t* head;
+				const uint32_t* weight;
+
+			public:
+				Iterator(const uint32_t* head, const uint32_t* weight) : head(head), weight(weight) {}
+
+				Edge operator*() const {
+					return { *head, *weight };
+				}
+
+				Iterator& operator++() {
+					head++;
+					weight++;
+					return *this;
+				}
+
+				bool operator==(const Iterator& other) const {
+					return head == other.head;
+				}
+
+				bool operator!=(const Iterator& other) const {
+					return head != other.head;
+				}
+		};
+
+	private:
+		const uint32_t* head;
+		const uint32_t* weight;
+		uint32_t n;
+
+	public:
+		ArcRange(const uint32_t* head, const uint32_t* weight, uint32_t n) : head(head), weight(weight), n(n) {}
+
+		Iterator begin() const {
+			return Iterator(head, weight);
+		}
+
+		Iterator end() const {
+			return Iterator(head + n, weight + n);
+		}
+
+		Edge operator[](uint32_t i) const {
+			return { head[i], weight[i] };
+		}
+
+		uint32_t size() const {
+			return n;
+		}
+
+		bool empty() const {
+			return n == 0;
+		}
+};
+
+// Removes parallel arcs from a graph in CSR format, keeping the one with the smallest weight.
+// This mirrors the behaviour of Graph::add_edge.
+void remove_parallel_arcs(std::vector<uint32_t>& first_out, std::vector<uint32_t>& head, std::vector<uint32_t>& weight) {
+	std::vector<std::pair<uint32_t, uint32_t>> buffer;
+	uint32_t write = 0;
+	for (node_t n = 0; n + 1 < first_out.size(); n++) {
+		buffer.clear();
+		for (uint32_t i = first_out[n]; i < first_out[n + 1]; i++) {
+			buffer.push_back(std::make_pair(head[i], weight[i]));
+		}
+		std::sort(buffer.begin(), buffer.end());
+		first_out[n] = write;
+		for (uint32_t i = 0; i < buffer.size(); i++) {
+			if (i > 0 && buffer[i].first == buffer[i - 1].first) {
+				continue;
+			}
+			head[write] = buffer[i].first;
+			weight[write] = buffer[i].second;
+			write++;
+		}
+	}
+	first_out.back() = write;
+	head.resize(write);
+	weight.resize(write);
+}
+
+// Returns true if some node has two arcs to the same head. Does not modify the arrays, so it can
+// be run on mapped vectors.
+bool has_parallel_arcs(const MappedVector<uint32_t>& first_out, const MappedVector<uint32_t>& head) {
+	std::vector<uint32_t> buffer;
+	for (node_t n = 0; n + 1 < first_out.size(); n++) {
+		buffer.assign(head.begin() + first_out[n], head.begin() + first_out[n + 1]);
+		std::sort(buffer.begin(), buffer.end());
+		if (std::adjacent_find(buffer.begin(), buffer.end()) != buffer.end()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Read-only graph in compressed sparse row format. Forward and reverse arcs are each stored
+// in three flat arrays (first_out, head, weight), so iterating over the arcs of a node is a
+// sequential scan. The topology can not be changed after construction, only arc weights.
+// Use Graph if edges need to be inserted or removed (e.g. during contraction).
+// The forward arrays may be memory mapped files (see read_graph), the reverse arrays are always
+// built in memory. Graphs that are only searched forward can skip building them.
+// Changing a weight (set_arc_weight, change_edge_weight) of a mapped graph copies the whole weight
+// array into memory first, the file is never written.
+class StaticGraph {
+
+	private:
+		MappedVector<uint32_t> first_out;
+		MappedVector<uint32_t> head;
+		MappedVector<uint32_t> weight;
+		std::vector<uint32_t> rev_first_out;
+		std::vector<uint32_t> rev_head;
+		std::vector<uint32_t> rev_weight;
+		std::vector<uint32_t> rev_arc_id; // Forward arc id of each reverse arc
+
+		// Builds the reverse arrays from the forward arrays with a counting sort.
+		void build_reverse() {
+			rev_first_out = std::vector<uint32_t>(size() + 1, 0);
+			rev_head = std::vector<uint32_t>(head.size());
+			rev_weight = std::vector<uint32_t>(head.size());
+			rev_arc_id = std::vector<uint32_t>(head.size());
+			for (uint32_t i = 0; i < head.size(); i++) {
+				rev_first_out[head[i] + 1]++;
+			}
+			for (node_t n = 0; n < size(); n++) {
+				rev_first_out[n + 1] += rev_first_out[n];
+			}
+			std::vector<uint32_t> insert_pos(rev_first_out.begin(), rev_first_out.end() - 1);
+			for (node_t n = 0; n < size(); n++) {
+				for (uint32_t i = first_out[n]; i < first_out[n + 1]; i++) {
+					uint32_t pos = insert_pos[head[i]]++;
+					rev_head[pos] = n;
+					rev_weight[pos] = weight[i];
+					rev_arc_id[pos] = i;
+				}
+			}
+		}
+
+	public:
+
+		StaticGraph() : first_out(std::vector<uint32_t>(1, 0)), rev_first_out(1, 0) {}
+
+		// Takes the arrays as they are. Parallel arcs should be removed beforehand.
+		StaticGraph(MappedVector<uint32_t> _first_out, MappedVector<uint32_t> _head, MappedVector<uint32_t> _weight, bool with_reverse = true) :
+			first_out(std::move(_first_out)),
+			head(std::move(_head)),
+			weight(std::move(_weight))
+		{
+			if (with_reverse) {
+				build_reverse();
+			}
+		}
+
+		// Builds the graph from an unordered list of (source, edge) pairs.
+		StaticGraph(uint32_t size, const std::vector<std::pair<node_t, Edge>>& edges, bool with_reverse = true) {
+			std::vector<uint32_t> _first_out(size + 1, 0);
+			std::vector<uint32_t> _head(edges.size());
+			std::vector<uint32_t> _weight(edges.size());
+			for (const auto& e : edges) {
+				_first_out[e.first + 1]++;
+			}
+			for (node_t n = 0; n < size; n++) {
+				_first_out[n + 1] += _first_out[n];
+			}
+			std::vector<uint32_t> insert_pos(_first_out.begin(), _first_out.end() - 1);
+			for (const auto& e : edges) {
+				uint32_t pos = insert_pos[e.first]++;
+				_head[pos] = e.second.target;
+				_weight[pos] = e.second.weight;
+			}
+			remove_parallel_arcs(_first_out, _head, _weight);
+			first_out = std::move(_first_out);
+			head = std::move(_head);
+			weight = std::move(_weight);
+			if (with_reverse) {
+				build_reverse();
+			}
+		}
+
+		explicit StaticGraph(const Graph& g, bool with_reverse = true) {
+			std::vector<uint32_t> _first_out(g.size() + 1, 0);
+			std::vector<uint32_t> _head;
+			std::vector<uint32_t> _weight;
+			_head.reserve(g.n_edges());
+			_weight.reserve(g.n_edges());
+			for (node_t n = 0; n < g.size(); n++) {
+				for (const Edge& e : g.get_out_arcs(n)) {
+					_head.push_back(e.target);
+					_weight.push_back(e.weight);
+				}
+				_first_out[n + 1] = _head.size();
+			}
+			first_out = std::move(_first_out);
+			head = std::move(_head);
+			weight = std::move(_weight);
+			if (with_reverse) {
+				build_reverse();
+			}
+		}
+
+		ArcRange get_out_arcs(node_t n) const {
+			return ArcRange(head.data() + first_out[n], weight.data() + first_out[n], first_out[n + 1] - first_out[n]);
+		}
+
+		bool has_reverse() const {
+			return rev_first_out.size() == first_out.size();
+		}
+
+		ArcRange get_rev_out_arcs(node_t n) const {
+			return ArcRange(rev_head.data() + rev_first_out[n], rev_weight.data() + rev_first_out[n], rev_first_out[n + 1] - rev_first_out[n]);
+		}
+
+		// Arc ids are indices into the forward arrays. Reverse arcs have their own ids (indices into the
+		// reverse arrays), get_forward_arc converts them to forward arc ids.
+		uint32_t get_out_arc_id(node_t n, uint32_t i) const {
+			return first_out[n] + i;
+		}
+
+		// Forward arc id of the i-th reverse arc of n
+		uint32_t get_rev_out_arc_id(node_t n, uint32_t i) const {
+			return rev_arc_id[rev_first_out[n] + i];
+		}
+
+		uint32_t get_forward_arc(uint32_t rev_arc) const {
+			return rev_arc_id[rev_arc];
+		}
+
+		uint32_t get_arc_weight(uint32_t arc) const {
+			return weight[arc];
+		}
+
+		// Only changes the forward arc, use change_edge_weight if the reverse arcs are needed.
+		void set_arc_weight(uint32_t arc, uint32_t new_weight) {
+			weight.mutable_data()[arc] = new_weight;
+		}
+
+		// Returns the id of the arc from u to v, i.e. its index in the forward arrays, or invalid_id.
+		uint32_t find_arc(node_t u, node_t v) const {
+			for (uint32_t i = first_out[u]; i < first_out[u + 1]; i++) {
+				if (head[i] == v) {
+					return i;
+				}
+			}
+			return invalid_id;
+		}
+
+		uint32_t get_edge_weight(node_t u, node_t v) const {
+			for (uint32_t i = first_out[u]; i < first_out[u + 1]; i++) {
+				if (head[i] == v) {
+					return weight[i];
+				}
+			}
+			return inf_weight;
+		}
+
+		void change_edge_weight(node_t u, node_t v, uint32_t new_weight) {
+			uint32_t* w = weight.mutable_data();
+			for (uint32_t i = first_out[u]; i < first_out[u + 1]; i++) {
+				if (head[i] == v) {
+					w[i] = new_weight;
+					break;
+				}
+			}
+			if (!has_reverse()) {
+				return;
+			}
+			for (uint32_t i = rev_first_out[v]; i < rev_first_out[v + 1]; i++) {
+				if (rev_head[i] == u) {
+					rev_weight[i] = new_weight;
+					break;
+				}
+			}
+		}
+
+		uint32_t size() const {
+			return first_out.size() - 1;
+		}
+
+		uint32_t n_edges() const {
+			return head.size();
+		}
+
+		std::vector<std::pair<node_t, node_t>> get_edges() const {
+			std::vector<std::pair<node_t, node_t>> ret;
+			ret.reserve(n_edges());
+			for (node_t n = 0; n < size(); n++) {
+				for (uint32_t i = first_out[n]; i < first_out[n + 1]; i++) {
+					ret.push_back(std::make_pair(n, head[i]));
+				}
+			}
+			return ret;
+		}
+
+		const MappedVector<uint32_t>& get_first_out() const { return first_out; }
+		const MappedVector<uint32_t>& get_head() const { return head; }
+		const MappedVector<uint32_t>& get_weight() const { return weight; }
+		const std::vector<uint32_t>& get_rev_first_out() const { return rev_first_out; }
+		const std::vector<uint32_t>& get_rev_head() const { return rev_head; }
+		const std::vector<uint32_t>& get_rev_weight() const { return rev_weight; }
+		const std::vector<uint32_t>& get_rev_arc_id() const { return rev_arc_id; }
+
+};
+
+// Builds the adjacency lists directly instead of calling add_edge for every arc. Parallel arcs are
+// merged into the one with the minimum weight like add_edge does.
+inline Graph::Graph(const StaticGraph& g) : adj_list(g.size()), rev_adj_list(g.size()) {
+	std::vector<uint32_t> index_of(g.size(), invalid_id); // Position of the arc to a head in the current list
+	for (node_t n = 0; n < g.size(); n++) {
+		std::vector<Edge>& edges = adj_list[n];
+		for (const Edge& e : g.get_out_arcs(n)) {
+			uint32_t& i = index_of[e.target];
+			if (i < edges.size() && edges[i].target == e.target) {
+				edges[i].weight = std::min(edges[i].weight, e.weight);
+			} else {
+				i = edges.size();
+				edges.push_back(e);
+			}
+		}
+	}
+	for (node_t n = 0; n < g.size(); n++) {
+		for (const Edge& e : adj_list[n]) {
+			rev_adj_list[e.target].push_back({ n, e.weight });
+		}
+	}
+}
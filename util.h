@@ -1,6 +1,7 @@
 #pragma once
 
 #include "graph.h"
+#include "static_graph.h"
 #include "dijkstra.h"
 #include <vector>
 #include <string>
@@ -17,7 +18,7 @@ std::string vector_to_string(const std::vector<T>& vec) {
 	return ret;
 }
 
-std::vector<node_t> get_dijkstra_rank_nodes(const Graph& g, node_t source) {
+std::vector<node_t> get_dijkstra_rank_nodes(const StaticGraph& g, node_t source) {
 	DijkstraService dij(g);
 	std::vector<std::pair<uint32_t, node_t>> dist;
 	std::vector<node_t> ret;
@@ -67,6 +68,23 @@ std::pair<Graph, Graph> split_graph(const Graph& ch, std::vector<uint32_t> ranki
 	return std::make_pair(forward_graph, backward_graph);
 }
 
+std::pair<StaticGraph, StaticGraph> split_graph(const StaticGraph& ch, const std::vector<uint32_t>& ranking) {
+	std::vector<std::pair<node_t, Edge>> forward_edges;
+	std::vector<std::pair<node_t, Edge>> backward_edges;
+	for (node_t n = 0; n < ch.size(); n++) {
+		for (const Edge& e : ch.get_out_arcs(n)) {
+			if (ranking[n] < ranking[e.target]) {
+				forward_edges.push_back(std::make_pair(n, e));
+			}
+			else {
+				backward_edges.push_back(std::make_pair(e.target, Edge{ n, e.weight }));
+			}
+		}
+	}
+	// Both halves are only searched forward, so no reverse arcs are built
+	return std::make_pair(StaticGraph(ch.size(), forward_edges, false), StaticGraph(ch.size(), backward_edges, false));
+}
+
 std::vector<uint32_t> order_to_ranking(const std::vector<node_t>& order) {
 	std::vector<uint32_t> ret = std::vector<uint32_t>(order.size());
 	for (uint32_t i = 0; i < order.size(); i++) {
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <ctype.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Vectors are stored in the RoutingKit format: the raw bytes of the elements without any header.
+
+template <class T>
+std::vector<T> load_vector(const std::string& path) {
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) {
+		throw std::runtime_error("Can't open " + path);
+	}
+	std::streamsize size = file.tellg();
+	if (size % sizeof(T) != 0) {
+		throw std::runtime_error("File size of " + path + " is not a multiple of the element size");
+	}
+	std::vector<T> ret(size / sizeof(T));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(ret.data()), size);
+	return ret;
+}
+
+template <class T>
+void save_vector(const std::string& path, const std::vector<T>& vec) {
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("Can't open " + path);
+	}
+	file.write(reinterpret_cast<const char*>(vec.data()), vec.size() * sizeof(T));
+}
+
+// Read-only mapping of a whole file. The mapping is shared, so several processes loading the
+// same graph share the page cache. On Windows the file is read into memory instead.
+class MappedFile {
+
+	private:
+		const void* addr = nullptr;
+		size_t length = 0;
+#ifdef _WIN32
+		std::vector<char> buffer;
+#endif
+
+	public:
+		MappedFile(const std::string& path) {
+#ifdef _WIN32
+			buffer = load_vector<char>(path);
+			addr = buffer.data();
+			length = buffer.size();
+#else
+			int fd = open(path.c_str(), O_RDONLY);
+			if (fd < 0) {
+				throw std::runtime_error("Can't open " + path);
+			}
+			struct stat st;
+			if (fstat(fd, &st) != 0) {
+				close(fd);
+				throw std::runtime_error("Can't stat " + path);
+			}
+			length = st.st_size;
+			if (length > 0) {
+				void* ptr = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+				if (ptr == MAP_FAILED) {
+					close(fd);
+					throw std::runtime_error("Can't map " + path);
+				}
+				addr = ptr;
+			}
+			close(fd);
+#endif
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		~MappedFile() {
+#ifndef _WIN32
+			if (addr != nullptr) {
+				munmap(const_cast<void*>(addr), length);
+			}
+#endif
+		}
+
+		const void* data() const {
+			return addr;
+		}
+
+		size_t size() const {
+			return length;
+		}
+};
+
+// Array that either owns its elements or views a MappedFile or a shared vector. Copies of a
+// mapped or shared vector share the elements. Requesting write access to them copies the elements
+// into memory first.
+template <class T>
+class MappedVector {
+
+	private:
+		std::vector<T> owned;
+		std::shared_ptr<const void> file; // MappedFile or std::vector<T>, empty if owned
+		const T* ptr = nullptr;
+		size_t n = 0;
+
+	public:
+		MappedVector() {}
+
+		MappedVector(std::vector<T> vec) : owned(std::move(vec)) {
+			ptr = owned.data();
+			n = owned.size();
+		}
+
+		MappedVector(std::shared_ptr<const MappedFile> _file) : file(_file) {
+			if (_file->size() % sizeof(T) != 0) {
+				throw std::runtime_error("Mapped file size is not a multiple of the element size");
+			}
+			ptr = static_cast<const T*>(_file->data());
+			n = _file->size() / sizeof(T);
+		}
+
+		MappedVector(std::shared_ptr<const std::vector<T>> shared) : file(shared) {
+			ptr = shared->data();
+			n = shared->size();
+		}
+
+		MappedVector(const MappedVector& other) : owned(other.owned), file(other.file), n(other.n) {
+			ptr = file ? other.ptr : owned.data();
+		}
+
+		MappedVector(MappedVector&& other) : owned(std::move(other.owned)), file(std::move(other.file)), ptr(other.ptr), n(other.n) {
+			other.ptr = nullptr;
+			other.n = 0;
+		}
+
+		MappedVector& operator=(MappedVector other) {
+			std::swap(owned, other.owned);
+			std::swap(file, other.file);
+			std::swap(ptr, other.ptr);
+			std::swap(n, other.n);
+			return *this;
+		}
+
+		const T& operator[](size_t i) const {
+			return ptr[i];
+		}
+
+		const T* data() const {
+			return ptr;
+		}
+
+		const T* begin() const {
+			return ptr;
+		}
+
+		const T* end() const {
+			return ptr + n;
+		}
+
+		const T& back() const {
+			return ptr[n - 1];
+		}
+
+		size_t size() const {
+			return n;
+		}
+
+		bool empty() const {
+			return n == 0;
+		}
+
+		bool is_mapped() const {
+			return (bool)file;
+		}
+
+		T* mutable_data() {
+			if (file) {
+				owned.assign(ptr, ptr + n);
+				file.reset();
+				ptr = owned.data();
+			}
+			return owned.data();
+		}
+
+		std::vector<T> to_vector() const {
+			return std::vector<T>(ptr, ptr + n);
+		}
+};
+
+template <class T>
+MappedVector<T> map_vector(const std::string& path) {
+	return MappedVector<T>(std::make_shared<const MappedFile>(path));
+}
+
+// Copies of the returned vector share the elements of vec instead of copying them.
+template <class T>
+MappedVector<T> share_vector(std::vector<T> vec) {
+	return MappedVector<T>(std::make_shared<const std::vector<T>>(std::move(vec)));
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "graph.h"
+#include "static_graph.h"
 #include <spatium/Image.h>
 #include <spatium/ImageIO.h>
 #include <spatium/gfx2d/Drawing.h>
@@ -50,7 +51,7 @@ float get_aspect_ratio(const std::vector<float>& lat, const std::vector<float>&
 class VisualisationService {
 
 private:
-	const Graph& g;
+	const StaticGraph& g;
 	std::vector<float>& lat;
 	std::vector<float>& lng;
 	spatium::Image<> image;
@@ -68,7 +69,7 @@ private:
 
 public:
 
-	VisualisationService(const Graph& g, std::vector<float>& lat, std::vector<float>& lng, int image_height) : g(g), lat(lat), lng(lng), image(std::floor(get_aspect_ratio(lat, lng) * image_height), image_height) {
+	VisualisationService(const StaticGraph& g, std::vector<float>& lat, std::vector<float>& lng, int image_height) : g(g), lat(lat), lng(lng), image(std::floor(get_aspect_ratio(lat, lng) * image_height), image_height) {
 		width = image.width();
 		height = image.height();
 		min_lat = find_min(lat);
@@ -91,9 +92,8 @@ public:
 
 	void draw_graph(Color c) {
 		for (node_t n = 0; n < g.size(); n++) {
-			const std::vector<Edge>& arcs = g.get_out_arcs(n);
-			for (auto j = arcs.begin(); j < arcs.end(); j++) {
-				draw_edge(n, j->target, c);
+			for (const Edge& e : g.get_out_arcs(n)) {
+				draw_edge(n, e.target, c);
 			}
 		}
 	}
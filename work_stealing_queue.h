@@ -0,0 +1,78 @@
+#pragma once
+
+#include "constants.h"
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <ctype.h>
+
+// Hands out the task indices 0..n-1 to a fixed number of workers. Every worker starts with an
+// equally sized block and takes tasks from the front of it. A worker whose block is empty steals
+// the back half of the largest remaining block. Blocks have their own locks, so workers only
+// contend while stealing.
+class WorkStealingQueue {
+
+private:
+	struct Block {
+		std::mutex lock;
+		uint32_t begin = 0;
+		uint32_t end = 0;
+	};
+
+	std::unique_ptr<Block[]> blocks;
+	uint32_t worker_count;
+
+	bool steal(uint32_t worker) {
+		while (true) {
+			uint32_t victim = invalid_id;
+			uint32_t victim_size = 0;
+			for (uint32_t i = 0; i < worker_count; i++) {
+				std::lock_guard<std::mutex> guard(blocks[i].lock);
+				uint32_t size = blocks[i].end - blocks[i].begin;
+				if (i != worker && size > victim_size) {
+					victim = i;
+					victim_size = size;
+				}
+			}
+			if (victim == invalid_id) {
+				return false;
+			}
+			std::lock(blocks[worker].lock, blocks[victim].lock);
+			std::lock_guard<std::mutex> own_guard(blocks[worker].lock, std::adopt_lock);
+			std::lock_guard<std::mutex> victim_guard(blocks[victim].lock, std::adopt_lock);
+			Block& v = blocks[victim];
+			if (v.begin == v.end) {
+				continue; // Emptied in the meantime, look again
+			}
+			uint32_t mid = v.begin + (v.end - v.begin) / 2;
+			blocks[worker].begin = mid;
+			blocks[worker].end = v.end;
+			v.end = mid;
+			return true;
+		}
+	}
+
+public:
+	WorkStealingQueue(uint32_t task_count, uint32_t worker_count) : blocks(new Block[worker_count]), worker_count(worker_count) {
+		for (uint32_t i = 0; i < worker_count; i++) {
+			blocks[i].begin = (uint64_t)task_count * i / worker_count;
+			blocks[i].end = (uint64_t)task_count * (i + 1) / worker_count;
+		}
+	}
+
+	// Returns the next task of the worker or invalid_id if all tasks are taken.
+	uint32_t pop(uint32_t worker) {
+		while (true) {
+			{
+				std::lock_guard<std::mutex> guard(blocks[worker].lock);
+				Block& b = blocks[worker];
+				if (b.begin < b.end) {
+					return b.begin++;
+				}
+			}
+			if (!steal(worker)) {
+				return invalid_id;
+			}
+		}
+	}
+};
@@ -2,7 +2,7 @@
 
 #include "graph.h"
 #include "dijkstra.h"
-#include "base/id_queue.h"
+#include "id_queue.h"
 #include <unordered_set>
 #include <aixlog.hpp>
 
@@ -14,20 +14,23 @@ constexpr float DEFAULT_ALPHA = 0.25;
 constexpr float DEFAULT_GAMMA = 0.8;
 constexpr float DEFAULT_EPS = 0.25;
 
+template <class GraphT>
 class XBDVService {
 
 private:
-	const Graph& g;
-	DijkstraService dijkstra_service;
+	const GraphT& g;
+	DijkstraService<GraphT> dijkstra_service;
 
 	MinIDQueue queue_fwd;
 	TimestampVector<node_t> dist_vec_fwd;
 	TimestampVector<node_t> parent_vec_fwd;
+	TimestampVector<uint32_t> parent_arc_vec_fwd; // Forward arc ids, only filled if GraphT has arc ids
 	std::unordered_set<node_t> search_space_fwd;
 
 	MinIDQueue queue_bwd;
 	TimestampVector<node_t> dist_vec_bwd;
 	TimestampVector<node_t> parent_vec_bwd;
+	TimestampVector<uint32_t> parent_arc_vec_bwd;
 	std::unordered_set<node_t> search_space_bwd;
 
 	bool test_limited_sharing(const Path& path, const Path& optimal_path, float gamma) {
@@ -113,15 +116,23 @@ private:
 	node_t step_forward_search() {
 		node_t best = queue_fwd.pop().id;
 		search_space_fwd.insert(best);
-		const std::vector<Edge>& arcs = g.get_out_arcs(best);
-		for (const Edge& e : arcs) {
+		count_settled(StatsScope::XBDV);
+		count_relaxed(StatsScope::XBDV, g.get_out_arcs(best).size());
+		uint32_t i = 0;
+		for (const Edge& e : g.get_out_arcs(best)) {
+			uint32_t arc_index = i++;
 			if (dist_vec_fwd.get(e.target) > dist_vec_fwd.get(best) + e.weight) {
 				dist_vec_fwd.set(e.target, dist_vec_fwd.get(best) + e.weight);
 				parent_vec_fwd.set(e.target, best);
+				if constexpr (has_arc_ids<GraphT>) {
+					parent_arc_vec_fwd.set(e.target, g.get_out_arc_id(best, arc_index));
+				}
 				if (!queue_fwd.contains_id(e.target)) {
 					queue_fwd.push({ e.target, dist_vec_fwd.get(e.target) });
+					count_push(StatsScope::XBDV);
 				} else {
 					queue_fwd.decrease_key({ e.target, dist_vec_fwd.get(e.target) });
+					count_decrease_key(StatsScope::XBDV);
 				}
 			}
 		}
@@ -131,15 +142,23 @@ private:
 	node_t step_backward_search() {
 		node_t best = queue_bwd.pop().id;
 		search_space_bwd.insert(best);
-		const std::vector<Edge>& arcs = g.get_rev_out_arcs(best);
-		for (const Edge& e : arcs) {
+		count_settled(StatsScope::XBDV);
+		count_relaxed(StatsScope::XBDV, g.get_rev_out_arcs(best).size());
+		uint32_t i = 0;
+		for (const Edge& e : g.get_rev_out_arcs(best)) {
+			uint32_t arc_index = i++;
 			if (dist_vec_bwd.get(e.target) > dist_vec_bwd.get(best) + e.weight) {
 				dist_vec_bwd.set(e.target, dist_vec_bwd.get(best) + e.weight);
 				parent_vec_bwd.set(e.target, best);
+				if constexpr (has_arc_ids<GraphT>) {
+					parent_arc_vec_bwd.set(e.target, g.get_rev_out_arc_id(best, arc_index));
+				}
 				if (!queue_bwd.contains_id(e.target)) {
 					queue_bwd.push({ e.target, dist_vec_bwd.get(e.target) });
+					count_push(StatsScope::XBDV);
 				} else {
 					queue_bwd.decrease_key({ e.target, dist_vec_bwd.get(e.target) });
+					count_decrease_key(StatsScope::XBDV);
 				}
 			}
 		}
@@ -148,9 +167,11 @@ private:
 
 	void run_dijkstra_bidirectional(node_t source, node_t target, uint32_t max_dist) {
 		queue_fwd.push({ source, 0 });
+		count_push(StatsScope::XBDV);
 		dist_vec_fwd.set(source, 0);
 		parent_vec_fwd.set(source, invalid_id);
 		queue_bwd.push({ target, 0 });
+		count_push(StatsScope::XBDV);
 		dist_vec_bwd.set(target, 0);
 		parent_vec_bwd.set(target, invalid_id);
 		while (!queue_fwd.empty() || !queue_bwd.empty()) {
@@ -227,6 +248,7 @@ private:
 
 	void run_forward_search(node_t source, uint32_t max_dist) {
 		queue_fwd.push({ source, 0 });
+		count_push(StatsScope::XBDV);
 		dist_vec_fwd.set(source, 0);
 		parent_vec_fwd.set(source, invalid_id);
 		search_space_fwd.clear();
@@ -240,15 +262,23 @@ private:
 			if (search_space_bwd.count(best) != 0) {
 				continue;
 			}
-			const std::vector<Edge>& arcs = g.get_out_arcs(best);
-			for (const Edge& e : arcs) {
+			count_settled(StatsScope::XBDV);
+			count_relaxed(StatsScope::XBDV, g.get_out_arcs(best).size());
+			uint32_t i = 0;
+			for (const Edge& e : g.get_out_arcs(best)) {
+				uint32_t arc_index = i++;
 				if (dist_vec_fwd.get(e.target) > dist_vec_fwd.get(best) + e.weight) {
 					dist_vec_fwd.set(e.target, dist_vec_fwd.get(best) + e.weight);
 					parent_vec_fwd.set(e.target, best);
+					if constexpr (has_arc_ids<GraphT>) {
+						parent_arc_vec_fwd.set(e.target, g.get_out_arc_id(best, arc_index));
+					}
 					if (!queue_fwd.contains_id(e.target)) {
 						queue_fwd.push({ e.target, dist_vec_fwd.get(e.target) });
+						count_push(StatsScope::XBDV);
 					} else {
 						queue_fwd.decrease_key({ e.target, dist_vec_fwd.get(e.target) });
+						count_decrease_key(StatsScope::XBDV);
 					}
 				}
 			}
@@ -257,6 +287,7 @@ private:
 
 	void run_backward_search(node_t target, uint32_t max_dist) {
 		queue_bwd.push({ target, 0 });
+		count_push(StatsScope::XBDV);
 		dist_vec_bwd.set(target, 0);
 		parent_vec_bwd.set(target, invalid_id);
 		search_space_bwd.clear();
@@ -270,15 +301,23 @@ private:
 			} else {
 				search_space_bwd.insert(best);
 			}
-			const std::vector<Edge>& arcs = g.get_rev_out_arcs(best);
-			for (const Edge& e : arcs) {
+			count_settled(StatsScope::XBDV);
+			count_relaxed(StatsScope::XBDV, g.get_rev_out_arcs(best).size());
+			uint32_t i = 0;
+			for (const Edge& e : g.get_rev_out_arcs(best)) {
+				uint32_t arc_index = i++;
 				if (dist_vec_bwd.get(e.target) > dist_vec_bwd.get(best) + e.weight) {
 					dist_vec_bwd.set(e.target, dist_vec_bwd.get(best) + e.weight);
 					parent_vec_bwd.set(e.target, best);
+					if constexpr (has_arc_ids<GraphT>) {
+						parent_arc_vec_bwd.set(e.target, g.get_rev_out_arc_id(best, arc_index));
+					}
 					if (!queue_bwd.contains_id(e.target)) {
 						queue_bwd.push({ e.target, dist_vec_bwd.get(e.target) });
+						count_push(StatsScope::XBDV);
 					} else {
 						queue_bwd.decrease_key({ e.target, dist_vec_bwd.get(e.target) });
+						count_decrease_key(StatsScope::XBDV);
 					}
 				}
 			}
@@ -286,34 +325,44 @@ private:
 	}
 
 	Path get_implicit_path(node_t n) {
-		uint32_t path_length = dist_vec_fwd.get(n) + dist_vec_bwd.get(n);
-		std::vector<node_t> path_nodes;
+		Path ret = { std::vector<node_t>(), dist_vec_fwd.get(n) + dist_vec_bwd.get(n), std::vector<uint32_t>() };
 		node_t current = n;
 		while (current != invalid_id) {
-			path_nodes.push_back(current);
+			ret.nodes.push_back(current);
+			if constexpr (has_arc_ids<GraphT>) {
+				if (parent_vec_fwd.get(current) != invalid_id) {
+					ret.edges.push_back(parent_arc_vec_fwd.get(current));
+				}
+			}
 			current = parent_vec_fwd.get(current);
 		}
-		std::reverse(path_nodes.begin(), path_nodes.end());
-		current = parent_vec_bwd.get(n);
-		while (current != invalid_id) {
-			path_nodes.push_back(current);
+		std::reverse(ret.nodes.begin(), ret.nodes.end());
+		std::reverse(ret.edges.begin(), ret.edges.end());
+		current = n;
+		while (parent_vec_bwd.get(current) != invalid_id) {
+			if constexpr (has_arc_ids<GraphT>) {
+				ret.edges.push_back(parent_arc_vec_bwd.get(current));
+			}
 			current = parent_vec_bwd.get(current);
+			ret.nodes.push_back(current);
 		}
-		return { path_nodes, path_length };
+		return ret;
 	}
 
 
 public:
 
-	XBDVService(const Graph& g) : 
+	XBDVService(const GraphT& g) : 
 		g(g), 
-		dijkstra_service(g),
+		dijkstra_service(g, StatsScope::XBDV),
 		queue_fwd(g.size()),
 		dist_vec_fwd(g.size(), inf_weight),
 		parent_vec_fwd(g.size(), invalid_id),
+		parent_arc_vec_fwd(g.size(), invalid_id),
 		queue_bwd(g.size()),
 		dist_vec_bwd(g.size(), inf_weight),
-		parent_vec_bwd(g.size(), invalid_id)
+		parent_vec_bwd(g.size(), invalid_id),
+		parent_arc_vec_bwd(g.size(), invalid_id)
 	{}
 
 	std::vector<Path> run_bdv(node_t source, node_t target, bool run_t_test = true, float alpha = DEFAULT_ALPHA, float eps = DEFAULT_EPS, float gamma = DEFAULT_GAMMA) {
@@ -363,6 +412,14 @@ public:
 		LOG(INFO) << sharing_success << " paths passed sharing test\n";
 		LOG(INFO) << local_optimality_success << " paths passed T-test\n";
 		// Cleanup
+		dist_vec_fwd.step_time();
+		dist_vec_bwd.step_time();
+		parent_vec_fwd.step_time();
+		parent_vec_bwd.step_time();
+		parent_arc_vec_fwd.step_time();
+		parent_arc_vec_bwd.step_time();
+		search_space_fwd.clear();
+		search_space_bwd.clear();
 		return alternative_paths;
 	}
 